@@ -0,0 +1,504 @@
+// Headless Benchmark for the Physics Engine
+//
+//   node bench.js [--steps=600] [--systems=64,1024,16384] [--workers=1,2,4] [--batch=1]
+//                 [--output=position,angles] [--encoding=float32|int16|delta] [--json]
+//                 [--suite=full|micro] [--frames=120]
+//   bench.html?steps=600&systems=64,1024&workers=1,2,4   (same options as query parameters)
+//
+// Two stages per system count:
+//   kernel   - SystemStore driven in-process: steps/sec, system-steps/sec and the split
+//              between integration, collision and correctEnergy time (timed with the
+//              free-flight skip off, since integration alone never skips), plus the same
+//              update with the free-flight skip turned off, with adaptive sub-stepping and
+//              with the energy correction deferred to every DEFERRED_CORRECT_EVERY steps
+//              and with event-driven integration (events processed per system-step).
+//   protocol - a pool of real physics workers driven through init and binary reset/update
+//              batch buffers (message mode) in the given output format (output-format.js),
+//              plus 'ping' round-trip latency.
+//
+// --suite=micro instead times single hot paths, each reset to a prepared state between
+// samples, at 64, 1024 and 10000 systems unless --systems is given. Every entry is
+// { bench, systems, samples, meanMs, p50Ms, p99Ms, nsPerSystem }:
+//   kernel.update.freeFlight.* / kernel.update.contact.*
+//              one update() step with every ball in free flight near the centre, or riding
+//              the wall; as .skip, .noSkip (free-flight skip off) and .events
+//   kernel.energy.settle / kernel.energy.measure
+//              the correctEnergy pass and the bare energy sum
+//   page.*     engine.js's batch unpack, trail and Canvas2D pass timings and a whole
+//              (tiled, at large counts) grid frame (microbench.js), over --frames frames
+
+const isNode = typeof process !== 'undefined' && Boolean(process.versions?.node);
+
+const DEFAULT_OPTIONS = {
+    steps: 600,
+    systems: [64, 1024, 16384],
+    workers: [1, 2, 4],
+    batch: 1, // FIXED_DT steps per 'update' message
+    pings: 200,
+    output: 'position,angles',
+    encoding: 'float32',
+    suite: 'full',
+    frames: 120, // page frames per micro case
+    json: false
+};
+const MICRO_SYSTEMS = [64, 1024, 10000];
+
+const KERNEL_ROUNDS = 3;
+const KERNEL_SETTLE_STEPS = 360;
+const DEFERRED_CORRECT_EVERY = 8;
+const MICRO_ROUNDS = 20;
+const MICRO_STEPS = 60; // per round: too short for a ball at the centre to reach the wall
+const MICRO_CONTACT_SPEED = 1000; // px/s along the wall
+
+// Kernel access: require() in Node, importScripts() globals in a browser worker. In a
+// browser the kernel's top-level constants share this script's global scope, so the step
+// and batch buffer constants (header: Float64 op, batch ID, dt, steps, first step, the
+// reduction record, payload bytes, keyframe, then the output) are only ever read from here.
+const kernel = isNode
+    ? require('./physics-worker.js')
+    : (importScripts('physics-worker.js'), {
+        SystemStore,
+        configure,
+        advance,
+        get store() { return store; },
+        FIXED_DT,
+        OP_UPDATE,
+        OP_RESET,
+        BATCH_HEADER_DOUBLES,
+        BATCH_PAYLOAD_BYTES
+    });
+
+const now = () => performance.now();
+
+function percentile(sorted, p) {
+    if (sorted.length === 0) return 0;
+    const idx = Math.min(sorted.length - 1, Math.floor(p * sorted.length));
+    return sorted[idx];
+}
+
+function describeEnvironment() {
+    if (isNode) {
+        const os = require('os');
+        return {
+            runtime: `node ${process.versions.node}`,
+            platform: `${process.platform}-${process.arch}`,
+            cpu: os.cpus()[0]?.model ?? 'unknown',
+            hardwareConcurrency: os.cpus().length
+        };
+    }
+    return {
+        runtime: navigator.userAgent,
+        platform: navigator.platform,
+        cpu: 'unknown',
+        hardwareConcurrency: navigator.hardwareConcurrency || 0
+    };
+}
+
+function summarize(bench, systems, samples) {
+    samples.sort((a, b) => a - b);
+    const meanMs = samples.reduce((a, b) => a + b, 0) / Math.max(1, samples.length);
+    return {
+        bench,
+        systems,
+        samples: samples.length,
+        meanMs,
+        p50Ms: percentile(samples, 0.5),
+        p99Ms: percentile(samples, 0.99),
+        nsPerSystem: meanMs * 1e6 / systems
+    };
+}
+
+// --- Kernel stage ---
+
+function timeSteps(steps, body) {
+    const start = now();
+    for (let s = 0; s < steps; s++) body();
+    return now() - start;
+}
+
+function benchKernel(numSystems, steps) {
+    const ids = [];
+    for (let i = 0; i < numSystems; i++) ids.push(i);
+    kernel.configure({ numSystems, systemIds: ids });
+    const s = kernel.store;
+
+    // Get past the initial drop (about 0.7 s) so wall contacts are in the mix.
+    kernel.advance(kernel.FIXED_DT, KERNEL_SETTLE_STEPS);
+    const start = s.data.slice();
+
+    // Each phase runs from the same state, and differences between phases isolate
+    // collision and correctEnergy cost. Integration without collision has no free-flight
+    // skip, so the split is timed with the skip off throughout (integrate, collide and
+    // the no-skip update); the skip's gain is total against totalWithoutFreeFlightSkip.
+    // The first round only warms up every variant; the best of the remaining rounds is
+    // kept.
+    let integrateMs = Infinity;
+    let collideMs = Infinity;
+    let updateMs = Infinity;
+    let noSkipMs = Infinity;
+    let adaptiveMs = Infinity;
+    let adaptiveSubSteps = 0;
+    let deferredMs = Infinity;
+    let eventsMs = Infinity;
+    let eventsPerSystemStep = 0;
+    for (let round = 0; round < KERNEL_ROUNDS + 1; round++) {
+        const roundSteps = round === 0 ? Math.min(steps, 30) : steps;
+        s.freeFlightSkip = false;
+        s.data.set(start);
+        const a = timeSteps(roundSteps, () => s.integrate(kernel.FIXED_DT, 0, numSystems, false));
+        s.data.set(start);
+        const b = timeSteps(roundSteps, () => s.integrate(kernel.FIXED_DT));
+        s.data.set(start);
+        const d = timeSteps(roundSteps, () => s.update(kernel.FIXED_DT));
+        s.freeFlightSkip = true;
+        s.data.set(start);
+        const c = timeSteps(roundSteps, () => s.update(kernel.FIXED_DT));
+        s.data.set(start);
+        s.adaptive = true;
+        const e = timeSteps(roundSteps, () => s.update(kernel.FIXED_DT));
+        s.adaptive = false;
+        // Later phases restore `start`, which puts every sub-step count back to the default.
+        const subSteps = s.subSteps.reduce((a, n) => a + n, 0) / numSystems;
+        s.data.set(start);
+        s.correctEvery = DEFERRED_CORRECT_EVERY;
+        let step = 0;
+        const f = timeSteps(roundSteps, () => kernel.advance(kernel.FIXED_DT, 1, 0, numSystems, step++));
+        s.correctEvery = 1;
+        s.data.set(start);
+        s.events = true;
+        s.eventsProcessed = 0;
+        const g = timeSteps(roundSteps, () => s.update(kernel.FIXED_DT));
+        s.events = false;
+        if (round === 0) continue;
+        integrateMs = Math.min(integrateMs, a);
+        collideMs = Math.min(collideMs, b);
+        updateMs = Math.min(updateMs, c);
+        noSkipMs = Math.min(noSkipMs, d);
+        adaptiveMs = Math.min(adaptiveMs, e);
+        deferredMs = Math.min(deferredMs, f);
+        eventsMs = Math.min(eventsMs, g);
+        eventsPerSystemStep = s.eventsProcessed / (numSystems * roundSteps);
+        adaptiveSubSteps = subSteps;
+    }
+
+    const systemSteps = numSystems * steps;
+    const nsPerSystemStep = (ms) => Math.max(0, ms) * 1e6 / systemSteps;
+    return {
+        systems: numSystems,
+        steps,
+        stepsPerSec: steps / (updateMs / 1000),
+        systemStepsPerSec: systemSteps / (updateMs / 1000),
+        nsPerSystemStep: {
+            integration: nsPerSystemStep(integrateMs),
+            collision: nsPerSystemStep(collideMs - integrateMs),
+            correctEnergy: nsPerSystemStep(noSkipMs - collideMs),
+            total: nsPerSystemStep(updateMs),
+            totalWithoutFreeFlightSkip: nsPerSystemStep(noSkipMs),
+            totalAdaptive: nsPerSystemStep(adaptiveMs),
+            totalDeferredCorrection: nsPerSystemStep(deferredMs),
+            totalEventDriven: nsPerSystemStep(eventsMs)
+        },
+        adaptiveMeanSubSteps: adaptiveSubSteps,
+        eventsPerSystemStep
+    };
+}
+
+// --- Micro suite ---
+
+// Puts every ball either at rest near its container's centre or sliding along the wall
+// at MICRO_CONTACT_SPEED, with the initial energy matching so correctEnergy is a no-op.
+function prepareMicroState(s, contact) {
+    for (let i = 0; i < s.count; i++) {
+        const a = i * 2.399963; // golden angle: spread over the wall
+        const r = contact ? s.maxDist[i] : 0.1 * s.maxDist[i] * (i % 7) / 7;
+        s.x[i] = r * Math.cos(a);
+        s.y[i] = r * Math.sin(a);
+        s.vx[i] = contact ? -MICRO_CONTACT_SPEED * Math.sin(a) : 0;
+        s.vy[i] = contact ? MICRO_CONTACT_SPEED * Math.cos(a) : 0;
+        s.angularVelocity[i] = 0;
+        s.containerAngularVelocity[i] = 0;
+        s.nextEvent[i] = NaN;
+        s.initialEnergy[i] = s.calculateEnergy(i);
+    }
+    return s.data.slice();
+}
+
+// Times `body` once per step over MICRO_ROUNDS rounds of MICRO_STEPS, restoring `start`
+// before each round; the first round is warm-up.
+function timeMicroSteps(s, start, body) {
+    const samples = [];
+    for (let round = 0; round < MICRO_ROUNDS + 1; round++) {
+        s.data.set(start);
+        for (let step = 0; step < MICRO_STEPS; step++) {
+            const t0 = now();
+            body();
+            const ms = now() - t0;
+            if (round > 0) samples.push(ms);
+        }
+    }
+    return samples;
+}
+
+function benchKernelMicro(numSystems) {
+    const ids = [];
+    for (let i = 0; i < numSystems; i++) ids.push(i);
+    kernel.configure({ numSystems, systemIds: ids });
+    const s = kernel.store;
+    const results = [];
+
+    for (const [name, contact] of [['freeFlight', false], ['contact', true]]) {
+        const start = prepareMicroState(s, contact);
+        const update = () => s.update(kernel.FIXED_DT);
+        results.push(summarize(`kernel.update.${name}.skip`, numSystems, timeMicroSteps(s, start, update)));
+        s.freeFlightSkip = false;
+        results.push(summarize(`kernel.update.${name}.noSkip`, numSystems, timeMicroSteps(s, start, update)));
+        s.freeFlightSkip = true;
+        s.events = true;
+        results.push(summarize(`kernel.update.${name}.events`, numSystems, timeMicroSteps(s, start, update)));
+        s.events = false;
+    }
+
+    const start = prepareMicroState(s, true);
+    results.push(summarize('kernel.energy.settle', numSystems, timeMicroSteps(s, start, () => s.settleEnergy(0, numSystems, kernel.FIXED_DT))));
+    results.push(summarize('kernel.energy.measure', numSystems, timeMicroSteps(s, start, () => s.measureEnergy())));
+    return results;
+}
+
+// Runs microbench.js after the page scripts in a global scope of their own (they share
+// constant names with the kernel loaded here): a dedicated worker, which in Node is a
+// worker thread given importScripts(). A vm context would do for scoping, but every global
+// lookup there (Math, top-level functions) goes through the context's interceptors and
+// costs more than the code being timed.
+function spawnPageWorker(search) {
+    if (!isNode) return new Worker('microbench.js' + search);
+    const { Worker } = require('worker_threads');
+    const w = new Worker(`
+        const { parentPort, workerData } = require('worker_threads');
+        const fs = require('fs');
+        const path = require('path');
+        const vm = require('vm');
+        globalThis.self = globalThis;
+        globalThis.location = { search: workerData.search };
+        globalThis.navigator ??= { hardwareConcurrency: require('os').cpus().length };
+        globalThis.postMessage = (data) => parentPort.postMessage(data);
+        globalThis.importScripts = (...files) => {
+            for (const file of files) {
+                vm.runInThisContext(fs.readFileSync(path.join(workerData.dir, file), 'utf8'), { filename: file });
+            }
+        };
+        importScripts('microbench.js');
+        parentPort.on('message', (data) => self.onmessage({ data }));
+    `, { eval: true, workerData: { search, dir: __dirname } });
+    const handle = {
+        onmessage: null,
+        postMessage: (msg) => w.postMessage(msg),
+        terminate: () => w.terminate()
+    };
+    w.on('message', (data) => handle.onmessage({ data }));
+    return handle;
+}
+
+async function benchPageMicro(systemCounts, frames, output) {
+    const search = '?' + new URLSearchParams({ output: output.groups.join(','), encoding: output.encoding });
+    const page = spawnPageWorker(search);
+    const reply = await request(page, { systems: systemCounts, frames });
+    page.terminate();
+    return reply.results;
+}
+
+async function runMicroBenchmark(opts, systemCounts, output, log) {
+    const micro = [];
+    const tiles = (m) => !m.tiled ? '' : m.tileCount ? `, ${m.tilesPerFrame.toFixed(1)} / ${m.tileCount} tiles` : ', tiled';
+    const logEntry = (m) => log(`${m.bench.padEnd(34)} systems=${String(m.systems).padEnd(6)}` +
+        ` mean/p50/p99=${m.meanMs.toFixed(4)}/${m.p50Ms.toFixed(4)}/${m.p99Ms.toFixed(4)}ms` +
+        `  ${m.nsPerSystem.toFixed(1)} ns/system` + (m.layout ? `  (${m.layout}${tiles(m)})` : ''));
+    for (const numSystems of systemCounts) {
+        for (const m of benchKernelMicro(numSystems)) {
+            micro.push(m);
+            logEntry(m);
+        }
+    }
+    for (const m of await benchPageMicro(systemCounts, opts.frames, output)) {
+        micro.push(m);
+        logEntry(m);
+    }
+    return micro;
+}
+
+// --- Protocol stage ---
+
+function spawnWorker() {
+    if (isNode) {
+        const { Worker } = require('worker_threads');
+        const w = new Worker(require('path').join(__dirname, 'physics-worker.js'));
+        const handle = {
+            onmessage: null,
+            postMessage: (msg, transfer) => w.postMessage(msg, transfer),
+            terminate: () => w.terminate()
+        };
+        w.on('message', (data) => handle.onmessage({ data }));
+        return handle;
+    }
+    return new Worker('physics-worker.js');
+}
+
+// Posts one message and resolves with the worker's next reply.
+function request(worker, msg, transfer) {
+    return new Promise((resolve) => {
+        worker.onmessage = (e) => resolve(e.data);
+        worker.postMessage(msg, transfer ?? []);
+    });
+}
+
+async function benchProtocol(numSystems, numWorkers, steps, batch, pings, output) {
+    const layout = outputLayout(output);
+    const pool = [];
+    const perWorker = Math.ceil(numSystems / numWorkers);
+    for (let w = 0; w < numWorkers; w++) {
+        const worker = spawnWorker();
+        const startId = Math.min(w * perWorker, numSystems);
+        const endId = Math.min(startId + perWorker, numSystems);
+        const systemIds = [];
+        for (let i = startId; i < endId; i++) systemIds.push(i);
+        worker.buffer = new ArrayBuffer(kernel.BATCH_HEADER_DOUBLES * 8 + systemIds.length * layout.names.length * layout.valueBytes);
+        pool.push(worker);
+        await request(worker, { type: 'init', numSystems, systemIds, output });
+    }
+
+    let batchId = 0;
+    let firstStep = 0;
+    let payloadBytes = 0;
+    const runBatch = async (op, dt, batchSteps) => {
+        batchId++;
+        const replies = await Promise.all(pool.map((worker) => {
+            const buffer = worker.buffer;
+            new Float64Array(buffer, 0, kernel.BATCH_HEADER_DOUBLES).set([op, batchId, dt, batchSteps, firstStep, 0]);
+            return request(worker, buffer, [buffer]);
+        }));
+        firstStep += batchSteps;
+        for (let w = 0; w < pool.length; w++) {
+            pool[w].buffer = replies[w];
+            payloadBytes += new Float64Array(replies[w], 0, kernel.BATCH_HEADER_DOUBLES)[kernel.BATCH_PAYLOAD_BYTES];
+        }
+    };
+
+    await runBatch(kernel.OP_RESET, 0, 0);
+    const batches = Math.max(1, Math.round(steps / batch));
+    for (let b = 0; b < Math.min(10, batches); b++) await runBatch(kernel.OP_UPDATE, kernel.FIXED_DT, batch);
+
+    const latencies = new Float64Array(batches);
+    payloadBytes = 0;
+    const start = now();
+    for (let b = 0; b < batches; b++) {
+        const t0 = now();
+        await runBatch(kernel.OP_UPDATE, kernel.FIXED_DT, batch);
+        latencies[b] = now() - t0;
+    }
+    const elapsedMs = now() - start;
+    latencies.sort();
+
+    const rtt = new Float64Array(pings);
+    for (let p = 0; p < pings; p++) {
+        const t0 = now();
+        await request(pool[0], { type: 'ping', sentAt: t0 });
+        rtt[p] = now() - t0;
+    }
+    rtt.sort();
+
+    pool.forEach((worker) => worker.terminate());
+
+    const totalSteps = batches * batch;
+    return {
+        systems: numSystems,
+        workers: numWorkers,
+        stepsPerBatch: batch,
+        output: layout.names.length + 'x' + layout.encoding,
+        payloadBytesPerBatch: payloadBytes / batches,
+        steps: totalSteps,
+        stepsPerSec: totalSteps / (elapsedMs / 1000),
+        systemStepsPerSec: totalSteps * numSystems / (elapsedMs / 1000),
+        batchLatencyMs: { p50: percentile(latencies, 0.5), p99: percentile(latencies, 0.99) },
+        pingRttMs: {
+            mean: rtt.reduce((a, b) => a + b, 0) / Math.max(1, pings),
+            p50: percentile(rtt, 0.5),
+            p99: percentile(rtt, 0.99)
+        }
+    };
+}
+
+// --- Driver ---
+
+async function runBenchmark(options, log) {
+    const opts = { ...DEFAULT_OPTIONS, ...options };
+    const results = { environment: describeEnvironment(), options: opts };
+    const output = parseOutputFormat(new URLSearchParams({ output: opts.output, encoding: opts.encoding }));
+    const fmt = (n) => n >= 1e6 ? (n / 1e6).toFixed(2) + 'M' : n >= 1e3 ? (n / 1e3).toFixed(1) + 'k' : n.toFixed(1);
+
+    log(`# ${results.environment.runtime} (${results.environment.hardwareConcurrency} threads)`);
+    if (opts.suite === 'micro') {
+        // Node has no canvas: microbench.js draws into a no-op context there.
+        results.environment.canvas = isNode ? 'none (JavaScript side only)' : 'OffscreenCanvas 2d';
+        results.micro = await runMicroBenchmark(opts, options.systems ? opts.systems : MICRO_SYSTEMS, output, log);
+        return results;
+    }
+    results.kernel = [];
+    results.protocol = [];
+    for (const numSystems of opts.systems) {
+        const k = benchKernel(numSystems, opts.steps);
+        results.kernel.push(k);
+        const ns = k.nsPerSystemStep;
+        log(`kernel   systems=${numSystems}  steps/s=${fmt(k.stepsPerSec)}  system-steps/s=${fmt(k.systemStepsPerSec)}` +
+            `  ns/system-step: integrate=${ns.integration.toFixed(1)} collide=${ns.collision.toFixed(1)}` +
+            ` energy=${ns.correctEnergy.toFixed(1)} (skip off) total=${ns.total.toFixed(1)}` +
+            ` (no skip ${ns.totalWithoutFreeFlightSkip.toFixed(1)},` +
+            ` adaptive ${ns.totalAdaptive.toFixed(1)} @ ${k.adaptiveMeanSubSteps.toFixed(1)} sub-steps,` +
+            ` correct/${DEFERRED_CORRECT_EVERY} ${ns.totalDeferredCorrection.toFixed(1)},` +
+            ` events ${ns.totalEventDriven.toFixed(1)} @ ${k.eventsPerSystemStep.toFixed(2)} events)`);
+
+        for (const numWorkers of opts.workers) {
+            const p = await benchProtocol(numSystems, numWorkers, opts.steps, opts.batch, opts.pings, output);
+            results.protocol.push(p);
+            log(`protocol systems=${numSystems} workers=${numWorkers} batch=${opts.batch} output=${p.output}` +
+                `  steps/s=${fmt(p.stepsPerSec)}  system-steps/s=${fmt(p.systemStepsPerSec)}` +
+                `  batch p50/p99=${p.batchLatencyMs.p50.toFixed(3)}/${p.batchLatencyMs.p99.toFixed(3)}ms` +
+                ` ${(p.payloadBytesPerBatch / 1024).toFixed(1)} KiB` +
+                `  ping p50/p99=${p.pingRttMs.p50.toFixed(3)}/${p.pingRttMs.p99.toFixed(3)}ms`);
+        }
+    }
+    return results;
+}
+
+// Parses "--key=value" / "key=value" pairs; list options take comma-separated numbers.
+function parseOptions(pairs) {
+    const opts = {};
+    for (const [key, value] of pairs) {
+        if (key === 'json') opts.json = value !== 'false';
+        else if (key === 'output' || key === 'encoding' || key === 'suite') opts[key] = value;
+        else if (key === 'systems' || key === 'workers') opts[key] = value.split(',').map(Number).filter((n) => n > 0);
+        else if (key in DEFAULT_OPTIONS) opts[key] = Number(value);
+    }
+    return opts;
+}
+
+if (isNode && require.main === module) {
+    const pairs = process.argv.slice(2).map((arg) => {
+        const [key, value = 'true'] = arg.replace(/^--/, '').split('=');
+        return [key, value];
+    });
+    const opts = parseOptions(pairs);
+    runBenchmark(opts, opts.json ? () => {} : (line) => console.log(line)).then((results) => {
+        if (opts.json) console.log(JSON.stringify(results, null, 2));
+        process.exit(0);
+    });
+} else if (!isNode) {
+    // bench.html runs this file as a dedicated worker and sends { options } to start.
+    self.onmessage = (e) => {
+        const opts = parseOptions(Object.entries(e.data.options ?? {}));
+        runBenchmark(opts, (line) => self.postMessage({ type: 'log', line }))
+            .then((results) => self.postMessage({ type: 'done', results }));
+    };
+}
+
+if (isNode) {
+    module.exports = { runBenchmark, benchKernel, benchKernelMicro, benchProtocol, describeEnvironment, percentile };
+}
@@ -0,0 +1,2151 @@
+/**
+ * Parallel Precision Physics Engine with Web Workers
+ * Simulates many independent rigid body systems (64 by default) across multiple CPU cores
+ *
+ * Runs on the page (index.html) or inside render-worker.js on an OffscreenCanvas.
+ * startEngine(host) hands it the canvases, a viewport() size and a ui sink for the stat
+ * panel, so nothing here touches the DOM.
+ */
+
+let host = null;
+let canvas = null;
+let ctx = null;
+let glRenderer = null; // GlRenderer (renderer-gl.js) when WebGL2 is in use, else Canvas2D via ctx
+
+// Canvas2D only: the background and container rings are identical from frame to frame
+// while the overlay transition is settled, so they are drawn once into this layer and
+// blitted. resize() and any transition movement invalidate it.
+let ringLayer = null;
+let ringLayerCtx = null;
+let ringLayerT = -1; // overlay transition the layer was drawn at (-1 = stale)
+
+// ?trails=incremental (Canvas2D): trails accumulate in TRAIL_LAYERS transparent layers
+// instead of being re-stroked in full. Each frame adds one segment per system to the
+// head layer; every TRAIL_LENGTH / TRAIL_LAYERS frames the oldest layer is cleared and
+// becomes the head, so visible trails span between (TRAIL_LAYERS - 1) / TRAIL_LAYERS
+// and all of TRAIL_LENGTH.
+const TRAIL_LAYERS = 4;
+let trailLayers = []; // { canvas, ctx }
+let trailLayerHead = 0;
+let trailLayerFrames = 0; // frames drawn into the head layer
+let trailLayersT = -1; // overlay transition the layers were drawn at (-1 = stale)
+
+// Canvas2D level of detail, by on-screen container radius in pixels: crosshairs and ball
+// orientation lines need LOD_DETAIL_PX; below LOD_POINT_PX balls become dots and trails
+// are skipped. A settled overlay of DENSITY_MIN_SYSTEMS or more shows a density map
+// instead of individual trails.
+const LOD_DETAIL_PX = 12;
+const LOD_POINT_PX = 3;
+const DENSITY_MIN_SYSTEMS = 256;
+const DENSITY_BINS = 128;
+const DENSITY_DECAY = 0.98; // per frame, about TRAIL_LENGTH / 4 frames of memory
+let densityCanvas = null;
+let densityCtx = null;
+let densityImage = null;
+let densityCounts = null;
+let densityActive = false; // density map drawn last frame (counts are warm)
+
+// ?tiles= (Canvas2D, settled grid layout): the frame stays on the canvas between frames,
+// split into tiles of whole grid cells about TILE_PX square. Each frame redraws only the
+// tiles whose systems moved visibly (TILE_CHANGE_PX) since they were last drawn, most
+// changed and longest waiting first, until ?renderbudget= ms (TILE_BUDGET_MS) have gone;
+// leftover tiles keep their old picture and lead the next frame. Large grids so refresh
+// at a lower per-tile rate instead of overrunning the frame. auto tiles from
+// TILED_MIN_SYSTEMS systems, on always, off never.
+const TILE_PX = 128;
+const TILE_CHANGE_PX = 0.5;
+const TILE_BUDGET_MS = 8;
+const TILED_MIN_SYSTEMS = 4096;
+const TILE_DRAWN_STRIDE = 6; // per system as last drawn: ballX, ballY, ballAngle, containerAngle, trail tail x, y
+let tileCols = 0;
+let tileRows = 0;
+let tileCellCols = 1; // grid cells per tile
+let tileCellRows = 1;
+let systemTile = null; // tile index per system
+let tileChange = null; // px moved since drawn, this frame
+let tileAge = null; // frames since drawn
+let tileStale = null; // 1 = must be redrawn whatever it shows (layout, reset)
+let tilePriority = null;
+let tileOrder = null;
+let tileDrawn = null; // TILE_DRAWN_STRIDE floats per system
+let tilesT = -1; // overlay transition the canvas holds tiles for (-1 = stale)
+let tileCostMs = 0; // running mean draw cost per system, for the budget
+let tilesDrawn = 0; // last tiled frame
+let tilesPending = 0;
+let graphCanvas = null;
+let graphCtx = null;
+
+// Not every browser exposes requestAnimationFrame to a render worker; fall back to a
+// 60 Hz timer there.
+const requestFrame = typeof requestAnimationFrame === 'function'
+    ? (callback) => requestAnimationFrame(callback)
+    : (callback) => setTimeout(() => callback(performance.now()), 1000 / 60);
+
+// --- Constants ---
+const DEFAULT_NUM_SYSTEMS = 64;
+const MAX_NUM_SYSTEMS = 100000;
+const CONTAINER_RADIUS = 300;
+const BALL_RADIUS = 30;
+const TWO_PI = Math.PI * 2;
+const STATE_STRIDE = 4; // ballX, ballY, ballAngle, containerAngle (must match worker)
+const TRAIL_LENGTH = 200;
+const UI_UPDATE_INTERVAL_MS = 1000 / 30;
+const PERF_UPDATE_INTERVAL_MS = 500;
+const PERF_SAMPLES = 240; // per collector ring
+
+// Fixed timestep / pipelining
+const FIXED_DT = 1/180;
+const MAX_FRAME_TIME = 0.25;
+const PIPELINE_DEPTH = 3; // batches allowed in flight ahead of the newest complete snapshot
+// Accumulated debt is coalesced into one batch of up to this many FIXED_DT steps.
+const MAX_STEPS_PER_BATCH = Math.ceil(MAX_FRAME_TIME / FIXED_DT);
+// In-flight batches plus the two completed snapshots the renderer interpolates between.
+const SNAPSHOT_SLOTS = PIPELINE_DEPTH + 2;
+
+// Worker command ops (must match worker)
+const OP_UPDATE = 1;
+const OP_RESET = 2;
+
+// Work-stealing claim words (must match worker): the low bits of the batch ID above the
+// count of chunks claimed, so a worker still on an older batch of the slot claims nothing.
+const CLAIM_CHUNK_BITS = 16;
+const CLAIM_TAG_MASK = 0x7fff;
+
+// Message-mode batch buffer header, Float64 fields ahead of the output (must match worker).
+// The page fills in the command; the worker answers in the same buffer.
+const BATCH_OP = 0;
+const BATCH_ID = 1;
+const BATCH_DT = 2;
+const BATCH_STEPS = 3;
+const BATCH_FIRST_STEP = 4;
+const BATCH_REDUCTION = 5; // REDUCTION_DOUBLES
+const BATCH_PAYLOAD_BYTES = 13;
+const BATCH_KEYFRAME = 14;
+const BATCH_HEADER_DOUBLES = 15;
+const BATCH_HEADER_BYTES = BATCH_HEADER_DOUBLES * 8;
+
+// Reduction record each worker returns per batch (must match worker): energy, the ball
+// x, y and distance sums over its systems and, on analytics samples, the divergence of
+// neighbouring systems (pair count, summed ln(separation / initial), max separation and
+// pairs further apart than a ball radius).
+const R_ENERGY = 0;
+const R_SUM_X = 1;
+const R_SUM_Y = 2;
+const R_SUM_DIST = 3;
+const R_PAIRS = 4;
+const R_LOG_SEPARATION = 5;
+const R_MAX_SEPARATION = 6;
+const R_DIVERGED = 7;
+const REDUCTION_DOUBLES = 8;
+
+// --- Worker Pool ---
+// The pool holds one worker per hardware thread, or ?workers=N. Stepping starts on worker 0
+// alone as soon as it is up; once the whole pool is, the active count moves to N, or with
+// the default ?workers=auto to the count calibratePool() picks.
+const pageParams = new URLSearchParams(location.search);
+const requestedWorkers = parseInt(pageParams.get('workers'), 10);
+const poolPolicy = requestedWorkers > 0 ? 'fixed' : 'auto';
+const numWorkers = poolPolicy === 'fixed' ? requestedWorkers : navigator.hardwareConcurrency || 4;
+const workers = [];
+// Calibration: ping round trips to an idle worker, then its step cost on a scratch store.
+const CALIBRATION_PINGS = 8;
+const CALIBRATION_SYSTEMS = 256;
+const CALIBRATION_STEPS = 30;
+const STEPS_PER_FRAME = Math.max(1, Math.round(1 / (60 * FIXED_DT)));
+
+// Cross-origin isolated pages (COOP/COEP headers) share one state arena with the
+// workers and signal steps through Atomics instead of posting a message per batch.
+const useSharedState = self.crossOriginIsolated === true &&
+    typeof SharedArrayBuffer === 'function' &&
+    typeof Atomics.waitAsync === 'function';
+
+// In shared mode the whole system store lives in shared memory and workers claim chunks
+// of each batch from an atomic counter, so the step tracks the average load rather than
+// the slowest static slice. ?scheduler=static keeps the fixed contiguous slices.
+const useWorkStealing = useSharedState && pageParams.get('scheduler') !== 'static';
+const SYSTEM_STORE_FIELDS = 31; // Float64 columns per system (must match worker NUM_FIELDS)
+
+// Workers advance balls in closed form while they provably cannot reach the wall;
+// ?freeflight=0 runs every sub-step explicitly instead.
+const freeFlightSkip = pageParams.get('freeflight') !== '0';
+
+// ?substeps=adaptive lets each system pick its own sub-step count against an energy
+// error bound (?accuracy=, relative error per step); otherwise every system runs 16.
+const adaptiveSubSteps = pageParams.get('substeps') === 'adaptive';
+const subStepAccuracy = parseFloat(pageParams.get('accuracy')) > 0 ? parseFloat(pageParams.get('accuracy')) : undefined;
+
+// ?integrator=events replaces the sub-step loop with event-driven integration: exact
+// parabolas between wall contacts, taken from a per-step calendar queue in the workers.
+const eventIntegration = pageParams.get('integrator') === 'events';
+
+// ?correctevery=K runs the workers' energy correction after every Kth step only (default 1).
+const correctEvery = parseInt(pageParams.get('correctevery'), 10) > 1 ? parseInt(pageParams.get('correctevery'), 10) : 1;
+
+// ?sweep= runs a parameter-sweep ensemble (ensemble.js): every system gets its own physics
+// constants. The workers expand the spec themselves; the page only needs the ball radii.
+const ensembleSpec = parseEnsembleSpec(pageParams);
+
+// ?analytics=N has the workers sample neighbour divergence (finite-time Lyapunov
+// estimates) every N steps for the overlay; ?analytics alone samples every
+// ANALYTICS_DEFAULT_EVERY steps.
+const ANALYTICS_DEFAULT_EVERY = 30;
+const analyticsEvery = !pageParams.has('analytics') ? 0
+    : parseInt(pageParams.get('analytics'), 10) > 0 ? parseInt(pageParams.get('analytics'), 10) : ANALYTICS_DEFAULT_EVERY;
+
+// ?output= / ?encoding= pick the values and encoding message-mode batches carry back
+// (output-format.js); by default the float32 render state. Decoded into the snapshot ring,
+// and velocities (when requested) into velocityRing.
+const outputFormat = parseOutputFormat(pageParams);
+const batchOutput = outputLayout(outputFormat);
+const batchOutputIsState = batchOutput.encoding === 'float32' && batchOutput.names.join() === 'x,y,angle,containerAngle';
+const OUTPUT_TARGETS = { x: 0, y: 1, angle: 2, containerAngle: 3, vx: 4, vy: 5 }; // ring field, or 4 + velocity field
+const batchOutputTargets = Int8Array.from(batchOutput.names, (name) => OUTPUT_TARGETS[name]);
+
+// ?trails=incremental draws Canvas2D trails into retained layers (see TRAIL_LAYERS).
+const useIncrementalTrails = pageParams.get('trails') === 'incremental';
+
+// ?tiles=auto|on|off and ?renderbudget=ms: the tiled Canvas2D grid (see TILE_PX).
+const tileMode = ['on', 'off'].includes(pageParams.get('tiles')) ? pageParams.get('tiles') : 'auto';
+const tileBudgetMs = parseFloat(pageParams.get('renderbudget')) > 0 ? parseFloat(pageParams.get('renderbudget')) : TILE_BUDGET_MS;
+
+// Trajectory recording (recorder.js): ?record=0-15,40 picks systems (default the first
+// RECORD_DEFAULT_SYSTEMS), ?recordevery=N the step interval and ?recordsink=opfs writes to
+// the origin private file system instead of a download.
+const RECORD_DEFAULT_SYSTEMS = 64;
+const RECORD_DEFAULT_EVERY = 6;
+const recordEvery = parseInt(pageParams.get('recordevery'), 10) > 0 ? parseInt(pageParams.get('recordevery'), 10) : RECORD_DEFAULT_EVERY;
+const recordSink = pageParams.get('recordsink') === 'opfs' ? 'opfs' : 'download';
+
+// --- Scheduler policy ---
+// ?background= picks what a hidden page does: pause (default) stops dispatching, leaving
+// the workers idle, and resumes without the hidden time; catchup also idles but simulates
+// the hidden time (up to CATCHUP_MAX_SECONDS) on return in large batches; full keeps
+// stepping in real time from a BACKGROUND_TICK_MS timer, without drawing.
+// ?power=auto (default) halves the active worker count while the host reports battery power
+// or serious CPU pressure (thermal throttling); ?power=full always uses every worker.
+const backgroundPolicy = ['catchup', 'full'].includes(pageParams.get('background')) ? pageParams.get('background') : 'pause';
+const powerPolicy = pageParams.get('power') === 'full' ? 'full' : 'auto';
+const BACKGROUND_TICK_MS = 1000; // hidden-page timers are clamped to about this anyway
+const BACKGROUND_MAX_STEPS_PER_BATCH = 4 * Math.round(1 / FIXED_DT);
+const CATCHUP_MAX_SECONDS = 600;
+const CATCHUP_MAX_STEPS_PER_BATCH = 8 * MAX_STEPS_PER_BATCH;
+// Catch-up batches double while frames and batches stay within these budgets and halve
+// (down to MAX_STEPS_PER_BATCH) when either overruns.
+const CATCHUP_FRAME_BUDGET_MS = 50;
+const CATCHUP_BATCH_BUDGET_MS = 100;
+
+let pageHidden = false;
+let hiddenSince = 0;
+let loopRunning = false; // a frame (or the background timer) is scheduled
+let backgroundTimer = null;
+let catchUpSteps = 0; // hidden-time steps still to dispatch
+let catchUpBatchSteps = MAX_STEPS_PER_BATCH;
+let activeWorkers = 1; // workers with a share of the systems (see Worker Pool)
+let wantedWorkers = 1; // pool size after the power policy; applied once idle
+let powerConstrained = false;
+let poolSized = false; // pool is up (and calibrated), so wantedWorkers applies
+let calibration = null; // { messageMs, systemStepMs }
+
+// --- Per-system state (sized by allocateSystems; ?systems=N sets the starting count) ---
+let numSystems = 0;
+let snapshotFloats = 0;
+let stealChunk = 1;
+let stealChunks = 0;
+let overlayAlpha = 1;
+let gridCols = 1;
+let gridRows = 1;
+
+let controlLayout = null;
+let sharedControlBuffer = null;
+let sharedControl = null;
+let sharedControlF64 = null;
+let sharedStoreBuffer = null;
+
+// Ring of completed state snapshots, each indexed by system ID: [id * STATE_STRIDE + field].
+// Batch b is written to slot b % SNAPSHOT_SLOTS; workers write it directly in shared mode.
+let snapshotRing = null;
+let velocityRing = null; // same slots, [id * 2 + (vx, vy)], when the batch output has velocity
+// Decoder state for int16/delta batch output, [id * values + value]: the last value received
+// and, for angles, the unwrapped angle in quanta (so interpolation never spins backwards).
+let outputPrevious = null;
+let outputUnwrapped = null;
+const slotPending = new Int32Array(SNAPSHOT_SLOTS);
+const slotEnergy = new Float64Array(SNAPSHOT_SLOTS);
+const slotEnergyCompensation = new Float64Array(SNAPSHOT_SLOTS); // Neumaier error term of slotEnergy
+const slotSums = new Float64Array(SNAPSHOT_SLOTS * REDUCTION_DOUBLES); // R_SUM_* per slot (R_ENERGY unused)
+const slotIsReset = new Uint8Array(SNAPSHOT_SLOTS); // SLOT_RESET / SLOT_RESTORE, else 0
+const slotSteps = new Int32Array(SNAPSHOT_SLOTS);
+const slotDispatchTime = new Float64Array(SNAPSHOT_SLOTS);
+
+const SLOT_RESET = 1;
+const SLOT_RESTORE = 2;
+
+// --- Snapshot / Restore ---
+// A snapshot blob is the full double-precision SystemStore of every system plus the step
+// count since the last reset (little-endian):
+//    0  u32  SNAPSHOT_MAGIC          4  u16  SNAPSHOT_VERSION     6  u16  fields per system
+//    8  u32  system count           12  u32  reserved (0)
+//   16  f64  steps since reset      24  f64  FIXED_DT
+//   32  f64  columns: SYSTEM_STORE_FIELDS runs of `system count` values (worker field order)
+const SNAPSHOT_MAGIC = 0x4e534c52; // 'RLSN'
+const SNAPSHOT_VERSION = 1;
+const SNAPSHOT_HEADER_BYTES = 32;
+const STORE_INITIAL_ENERGY_FIELD = 8; // worker F_INITIAL_ENERGY
+const STORE_BALL_RADIUS_FIELD = 11; // worker F_BALL_RADIUS
+
+let simulationSteps = 0; // steps since the last reset, as of latestBatchId
+let dispatchedSteps = 0; // the same, as of activeBatchId
+let recorder = null; // TrajectoryRecorder while recording
+// Pending snapshot/restore: dispatch pauses until every batch in flight has completed.
+// { kind, blob, resolve, reject, started, pending }
+let stateRequest = null;
+let restoredSteps = 0;
+let restoredInitialEnergy = 0;
+
+// --- Performance HUD ---
+// Collectors are preallocated rings (like the trail buffers), so sampling never allocates.
+function createSampleRing(capacity = PERF_SAMPLES) {
+    return { values: new Float64Array(capacity), head: 0, size: 0 };
+}
+
+function pushSample(ring, value) {
+    const values = ring.values;
+    values[ring.head] = value;
+    ring.head = ring.head + 1 === values.length ? 0 : ring.head + 1;
+    if (ring.size < values.length) ring.size++;
+}
+
+function ringMean(ring) {
+    let sum = 0;
+    for (let i = 0; i < ring.size; i++) sum += ring.values[i];
+    return ring.size > 0 ? sum / ring.size : 0;
+}
+
+// Sorts a copy in the shared scratch ring; unused entries sort to the end as Infinity.
+const percentileScratch = new Float64Array(PERF_SAMPLES);
+function ringPercentile(ring, p) {
+    if (ring.size === 0) return 0;
+    percentileScratch.fill(Infinity);
+    percentileScratch.set(ring.values.length === ring.size ? ring.values : ring.values.subarray(0, ring.size));
+    percentileScratch.sort();
+    return percentileScratch[Math.min(ring.size - 1, Math.floor(p * ring.size))];
+}
+
+const frameTimes = createSampleRing();
+const renderPassTimes = [createSampleRing(), createSampleRing(), createSampleRing()];
+const poolLatency = createSampleRing(); // whole-batch latency (work stealing has no per-worker split)
+const batchOutputBytes = createSampleRing(); // payload bytes per message-mode worker reply
+let lastBatchLatency = 0; // ms, newest completed batch (or worker share of one)
+let completedSteps = 0;
+let droppedSteps = 0;
+let lastPerfUpdate = 0;
+let lastPerfSteps = 0;
+
+// Render state, same layout as a snapshot and indexed by system ID. It views the newest
+// snapshot's ring slot directly unless the frame falls between snapshots, in which case
+// it is interpolated into interpolatedState.
+let stateView = null;
+let interpolatedState = null;
+let slotViews = [];
+
+// Trail points, TRAIL_LENGTH per system at [id * TRAIL_LENGTH]. Every system gains a
+// point on the same frame, so one head and size serve the whole pool.
+let trailX = null;
+let trailY = null;
+let trailHead = 0;
+let trailSize = 0;
+let trailColors = [];
+let ballRadii = null; // per-system ball radius when an ensemble sweeps it, else BALL_RADIUS
+let gridCx = null;
+let gridCy = null;
+let drawCx = null;
+let drawCy = null;
+let drawVisible = null;
+
+let cellW = 0;
+let cellH = 0;
+let overlayCenterX = 0;
+let overlayCenterY = 0;
+let lastUiUpdate = 0;
+
+// Shared control block, laid out here and handed to the workers in init (byte offsets):
+//   seq             Int32, newest published batch ID
+//   commands        per ring slot: Int32 op, Int32 steps, Float64 dt, Float64 first step
+//   done            Int32 per worker, newest batch it finished (static slices)
+//   claim/remaining Int32 per ring slot, chunk counters, claim tagged with its batch (work stealing)
+//   batchDone       Int32, newest batch with every chunk finished (work stealing)
+//   chunkDone       Int32 per chunk, newest batch finished on that chunk (work stealing)
+//   reductions      REDUCTION_DOUBLES Float64 per worker per ring slot
+function buildControlLayout() {
+    const align8 = (n) => Math.ceil(n / 8) * 8;
+    const layout = { seq: 0, commandBytes: 24, slots: SNAPSHOT_SLOTS };
+    let offset = 16;
+    layout.commandOffset = offset;
+    offset += SNAPSHOT_SLOTS * layout.commandBytes;
+    layout.doneOffset = offset;
+    offset = align8(offset + numWorkers * 4);
+    layout.claimOffset = offset;
+    offset += SNAPSHOT_SLOTS * 4;
+    layout.remainingOffset = offset;
+    offset += SNAPSHOT_SLOTS * 4;
+    layout.batchDoneOffset = offset;
+    offset += 4;
+    layout.chunkDoneOffset = offset;
+    offset = align8(offset + stealChunks * 4);
+    layout.reductionOffset = offset;
+    offset += numWorkers * SNAPSHOT_SLOTS * REDUCTION_DOUBLES * 8;
+    layout.byteLength = offset;
+    return layout;
+}
+
+// (Re)allocates every per-system buffer for `count` systems. Shared buffers are replaced
+// rather than grown; the workers pick up the new ones from the next init/resize.
+function allocateSystems(count) {
+    numSystems = count;
+    snapshotFloats = count * STATE_STRIDE;
+    stealChunk = Math.max(1, Math.min(1024, Math.ceil(count / (numWorkers * 4))));
+    stealChunks = Math.ceil(count / stealChunk);
+    overlayAlpha = Math.sqrt(1 / count);
+    gridCols = Math.ceil(Math.sqrt(count));
+    gridRows = Math.ceil(count / gridCols);
+
+    if (useSharedState) {
+        controlLayout = buildControlLayout();
+        sharedControlBuffer = new SharedArrayBuffer(controlLayout.byteLength);
+        sharedControl = new Int32Array(sharedControlBuffer);
+        sharedControlF64 = new Float64Array(sharedControlBuffer);
+        sharedStoreBuffer = useWorkStealing
+            ? new SharedArrayBuffer(SYSTEM_STORE_FIELDS * count * 8)
+            : null;
+
+        // Batch IDs keep counting across resizes; the new block starts "caught up".
+        Atomics.store(sharedControl, controlLayout.seq, activeBatchId);
+        sharedControl.fill(activeBatchId, controlLayout.doneOffset >> 2, (controlLayout.doneOffset >> 2) + numWorkers);
+        sharedControl[controlLayout.batchDoneOffset >> 2] = activeBatchId;
+        sharedControl.fill(activeBatchId, controlLayout.chunkDoneOffset >> 2, (controlLayout.chunkDoneOffset >> 2) + stealChunks);
+        stealSeenBatchId = activeBatchId;
+        stealWatching = false;
+    }
+
+    snapshotRing = new Float32Array(useSharedState
+        ? new SharedArrayBuffer(SNAPSHOT_SLOTS * snapshotFloats * 4)
+        : new ArrayBuffer(SNAPSHOT_SLOTS * snapshotFloats * 4));
+    slotViews = [];
+    for (let slot = 0; slot < SNAPSHOT_SLOTS; slot++) {
+        slotViews.push(snapshotRing.subarray(slot * snapshotFloats, (slot + 1) * snapshotFloats));
+    }
+    const hasVelocity = !useSharedState && batchOutput.names.includes('vx');
+    velocityRing = hasVelocity ? new Float32Array(SNAPSHOT_SLOTS * count * 2) : null;
+    const quantised = !useSharedState && batchOutput.encoding !== 'float32';
+    outputPrevious = new Int16Array(quantised ? count * batchOutput.names.length : 0);
+    outputUnwrapped = new Float64Array(quantised ? count * batchOutput.names.length : 0);
+    interpolatedState = new Float32Array(snapshotFloats);
+    for (let i = 0; i < count; i++) {
+        interpolatedState[i * STATE_STRIDE + 1] = -220;
+    }
+    stateView = interpolatedState;
+
+    ballRadii = null;
+    if (ensembleSpec?.ranges.some((r) => r.name === 'ballRadius')) {
+        const { names, columns } = buildEnsemble(ensembleSpec, count);
+        const d = names.indexOf('ballRadius');
+        ballRadii = Float32Array.from(columns.subarray(d * count, (d + 1) * count));
+    }
+
+    // The GPU renderer keeps its own trail ring.
+    if (glRenderer) {
+        glRenderer.allocate(count);
+        glRenderer.setBallRadii(ballRadii);
+    }
+    const trailFloats = glRenderer ? 0 : count * TRAIL_LENGTH;
+    trailX = new Float32Array(trailFloats);
+    trailY = new Float32Array(trailFloats);
+    trailHead = 0;
+    trailSize = 0;
+
+    trailColors = Array(count);
+    for (let i = 0; i < count; i++) {
+        trailColors[i] = `hsl(${(i * 360 / count)}, 70%, 60%)`;
+    }
+
+    gridCx = new Float32Array(count);
+    gridCy = new Float32Array(count);
+    drawCx = new Float32Array(count);
+    drawCy = new Float32Array(count);
+    drawVisible = new Uint8Array(count);
+
+    host.ui.text('system-count', ensembleSpec
+        ? `${count} (${ensembleSpec.design}: ${ensembleSpec.ranges.map((r) => r.name).join(', ')})`
+        : String(count));
+    host.ui.title(`Parallel Rigid Body Simulation (${count}x)`);
+}
+
+// Sends every worker its slice of the current system count (type 'init' or 'resize').
+// Only the first activeWorkers get systems; the rest idle (or, stealing, never claim).
+function partitionWorkers(type) {
+    const systemsPerWorker = Math.ceil(numSystems / activeWorkers);
+    for (let w = 0; w < numWorkers; w++) {
+        const worker = workers[w];
+        const startId = Math.min(w * systemsPerWorker, numSystems);
+        const endId = Math.min(startId + systemsPerWorker, numSystems);
+        const systemIds = [];
+        // Work-stealing workers can step any system, so each one views the whole store.
+        const firstId = useWorkStealing ? 0 : startId;
+        const lastId = useWorkStealing ? numSystems : endId;
+        for (let i = firstId; i < lastId; i++) {
+            systemIds.push(i);
+        }
+
+        worker.systemIds = systemIds;
+        if (useSharedState) {
+            worker.doneIndex = (controlLayout.doneOffset >> 2) + w;
+            worker.seenBatchId = activeBatchId;
+            worker.watching = false;
+            worker.postMessage({
+                type,
+                numSystems,
+                systemIds,
+                freeFlightSkip,
+                adaptiveSubSteps,
+                subStepAccuracy,
+                correctEvery,
+                eventIntegration,
+                analyticsEvery,
+                ensemble: ensembleSpec,
+                baseBatchId: activeBatchId,
+                parked: w >= activeWorkers,
+                shared: {
+                    snapshotBuffer: snapshotRing.buffer,
+                    snapshotFloats,
+                    controlBuffer: sharedControlBuffer,
+                    layout: controlLayout,
+                    slot: w,
+                    storeBuffer: sharedStoreBuffer,
+                    stealChunk
+                }
+            });
+        } else {
+            // One transfer buffer per batch that can be in flight, plus a pending reset.
+            worker.bufferPool = [];
+            worker.postMessage({ type, numSystems, systemIds, freeFlightSkip, adaptiveSubSteps, subStepAccuracy, correctEvery,
+                eventIntegration, analyticsEvery, ensemble: ensembleSpec, output: outputFormat });
+        }
+    }
+}
+
+// Fixed timestep variables
+let lastTime = performance.now();
+let accumulator = 0;
+
+let showTrails = true;
+let showOverlay = false;
+let overlayTransition = 0;
+let totalInitialEnergy = 0;
+let displayedTotalEnergy = 0;
+const displayedSums = new Float64Array(REDUCTION_DOUBLES); // R_SUM_* of the newest batch
+const divergence = new Float64Array(REDUCTION_DOUBLES); // R_PAIRS.. of the newest analytics sample
+let divergenceStep = 0; // simulationSteps of that sample
+// Energy graph: one total per UI tick in a ring as wide as the graph canvas (oldest at
+// energyHistoryHead once full). Each tick draws only the newest segment, scrolling the
+// canvas a column once the ring is full; the whole graph is redrawn only when stale.
+let energyHistory = new Float64Array(0);
+let energyHistoryHead = 0;
+let energyHistorySize = 0;
+let graphScroll = 0; // columns scrolled since the graph was cleared (keeps the dash phase)
+let graphStale = true;
+let layoutScale = 1;
+let overlayScale = 1;
+let initializedWorkers = 0;
+let isReady = false;
+let resizePending = 0;   // workers yet to acknowledge a resize
+let activeBatchId = 0;   // newest dispatched batch
+let resetBatchId = 0;    // batches older than the latest reset are stale
+let resetPending = false; // reset requested; stepSimulation dispatches it once the pipeline has room
+let latestBatchId = 0;   // newest batch completed by every worker (0 = none yet)
+let previousBatchId = 0; // completed batch before latestBatchId
+let stealSeenBatchId = 0;
+let stealWatching = false;
+
+const requestedSystems = parseInt(pageParams.get('systems'), 10);
+
+// host: { canvas, graphCanvas, viewport() -> { width, height, graphWidth, graphHeight },
+//         ui: { text(id, value), visible(id, shown), title(value), commit() },
+//         saveFile(name, arrayBuffer) }
+// The host calls resize() whenever viewport() changes.
+function startEngine(engineHost) {
+    host = engineHost;
+    canvas = host.canvas;
+    // WebGL2 unless ?renderer=2d; Canvas2D is the fallback when no WebGL2 context is available.
+    if (pageParams.get('renderer') !== '2d' && typeof GlRenderer === 'function') {
+        const gl = canvas.getContext('webgl2', { alpha: false, antialias: true, desynchronized: true });
+        if (gl) glRenderer = new GlRenderer(gl);
+    }
+    if (!glRenderer) initCanvas2d();
+    graphCanvas = host.graphCanvas;
+    graphCtx = graphCanvas.getContext('2d', { desynchronized: true });
+
+    showWorkerCount();
+    host.ui.visible('divergence-stats', analyticsEvery > 0);
+
+    for (let w = 0; w < numWorkers; w++) {
+        const worker = new Worker('physics-worker.js');
+        worker.index = w;
+        worker.latency = createSampleRing();
+        worker.transfer = [null]; // reused transfer list for batch buffers
+        worker.onmessage = (e) => handleWorkerMessage(worker, e);
+        workers.push(worker);
+    }
+
+    allocateSystems(Math.max(1, Math.min(MAX_NUM_SYSTEMS,
+        Number.isFinite(requestedSystems) ? requestedSystems : DEFAULT_NUM_SYSTEMS)));
+    partitionWorkers('init');
+    resize();
+}
+
+// Canvas2D renderer context and its offscreen layers (when OffscreenCanvas exists).
+function initCanvas2d() {
+    ctx = canvas.getContext('2d', { alpha: false, desynchronized: true });
+    if (typeof OffscreenCanvas !== 'function') return;
+    ringLayer = new OffscreenCanvas(1, 1);
+    ringLayerCtx = ringLayer.getContext('2d', { alpha: false });
+    densityCanvas = new OffscreenCanvas(DENSITY_BINS, DENSITY_BINS);
+    densityCtx = densityCanvas.getContext('2d');
+    densityImage = densityCtx.createImageData(DENSITY_BINS, DENSITY_BINS);
+    densityCounts = new Float32Array(DENSITY_BINS * DENSITY_BINS);
+    if (useIncrementalTrails) {
+        for (let k = 0; k < TRAIL_LAYERS; k++) {
+            const layerCanvas = new OffscreenCanvas(1, 1);
+            trailLayers.push({ canvas: layerCanvas, ctx: layerCanvas.getContext('2d') });
+        }
+    }
+}
+
+function showWorkerCount() {
+    const count = activeWorkers + ' / ' + numWorkers;
+    host.ui.text('worker-count', useWorkStealing ? count + ' (stealing)' : useSharedState ? count + ' (shared)' : count);
+}
+
+// Button commands, forwarded by the page in render-worker mode.
+function runEngineCommand(name, arg) {
+    if (name === 'reset') resetAll();
+    else if (name === 'trails') toggleTrails();
+    else if (name === 'overlay') toggleOverlay();
+    else if (name === 'scale') resizeMultiverse(numSystems * arg);
+    else if (name === 'snapshot') {
+        snapshotMultiverse().then((blob) => host.saveFile(`multiverse-${numSystems}x-${simulationSteps}.bin`, blob),
+            (err) => console.warn(err.message));
+    } else if (name === 'restore') restoreMultiverse(arg).catch((err) => console.warn(err.message));
+    else if (name === 'record') {
+        if (recorder) stopRecording();
+        else startRecording();
+    } else if (name === 'visibility') setPageVisible(arg);
+    else if (name === 'power') applyPowerState(arg);
+}
+
+// Parses ?record= ("0-15,40") into in-range system IDs.
+function parseRecordSystems(spec) {
+    const ids = [];
+    for (const part of spec.split(',')) {
+        const [first, last = first] = part.split('-').map((n) => parseInt(n, 10));
+        for (let id = Math.max(0, first); id <= Math.min(last, numSystems - 1); id++) ids.push(id);
+    }
+    return ids;
+}
+
+// Records every `every`th step of the given systems until stopRecording(). `sink` is a
+// recorder sink (see recorderStreamSink); by default the ?recordsink= choice.
+function startRecording({ systemIds, every = recordEvery, sink } = {}) {
+    if (!isReady || recorder) return null;
+    const spec = pageParams.get('record');
+    systemIds ??= spec ? parseRecordSystems(spec)
+        : Array.from({ length: Math.min(numSystems, RECORD_DEFAULT_SYSTEMS) }, (_, i) => i);
+    if (systemIds.length === 0) return null;
+    const name = `trajectory-${numSystems}x-${simulationSteps}.bin`;
+    sink ??= recordSink === 'opfs' ? recorderOpfsSink(name) : recorderDownloadSink(name, host.saveFile);
+    recorder = new TrajectoryRecorder(systemIds, every, FIXED_DT, sink);
+    host.ui.text('record-button', 'Stop Recording');
+    return recorder;
+}
+
+function stopRecording() {
+    if (!recorder) return Promise.resolve();
+    const stopped = recorder;
+    recorder = null;
+    host.ui.text('record-button', 'Record Trajectories');
+    host.ui.text('perf-record', 'off');
+    return stopped.stop().catch((err) => console.warn(err.message));
+}
+
+// Changes the system count without recreating workers. The initial spread of the
+// multiverse is defined over the whole count, so the resized multiverse restarts.
+function resizeMultiverse(count) {
+    // A snapshot or restore owns the layout until it finishes.
+    if (stateRequest) return;
+    applySystemCount(count);
+}
+
+// The resize itself; a restore calls it directly to reach its snapshot's count.
+function applySystemCount(count) {
+    count = Math.max(1, Math.min(MAX_NUM_SYSTEMS, Math.round(count)));
+    if (!isReady || resizePending > 0 || count === numSystems) return;
+    // Recorded system IDs belong to the old layout.
+    stopRecording();
+
+    // Everything still in flight belongs to the old layout.
+    resetBatchId = activeBatchId + 1;
+    latestBatchId = 0;
+    previousBatchId = 0;
+
+    allocateSystems(count);
+    updateWantedWorkers();
+    resize();
+    resizePending = numWorkers;
+    partitionWorkers('resize');
+}
+
+function expectedWorkerBufferBytes(worker) {
+    return BATCH_HEADER_BYTES + worker.systemIds.length * batchOutput.names.length * batchOutput.valueBytes;
+}
+
+function acquireWorkerBuffer(worker) {
+    const expectedBytes = expectedWorkerBufferBytes(worker);
+    const pool = worker.bufferPool;
+    while (pool.length > 0) {
+        const buffer = pool.pop();
+        if (buffer.byteLength === expectedBytes) return buffer;
+    }
+    return new ArrayBuffer(expectedBytes);
+}
+
+// Batch replies arrive as the bare buffer (see BATCH_HEADER_BYTES); everything else is a
+// { type } object.
+function handleWorkerMessage(worker, e) {
+    if (e.data instanceof ArrayBuffer) {
+        completeMessageBatch(worker, e.data);
+        return;
+    }
+    const { type } = e.data;
+    
+    if (type === 'initialized') {
+        initializedWorkers++;
+        // Worker 0 starts out with every system; the rest join once sized.
+        if (worker.index === 0) {
+            isReady = true;
+            resetAll();
+            loopRunning = true;
+            requestFrame(loop);
+        }
+        if (initializedWorkers === numWorkers) calibratePool();
+        return;
+    }
+
+    if (type === 'pong') {
+        worker.onpong?.(e.data.sentAt);
+        return;
+    }
+
+    if (type === 'calibrated') {
+        worker.oncalibrated?.(e.data.systemStepMs);
+        return;
+    }
+
+    if (type === 'resized') {
+        resizePending--;
+        if (resizePending > 0) return;
+        // A repartition resumes its restore (the pipeline was already drained).
+        if (stateRequest?.repartitioning) {
+            stateRequest.repartitioning = false;
+            beginStateRequest();
+        } else {
+            // The old layout's batches are all discarded, so the ring is free and the reset
+            // goes out now, even to a restore that waits on it (stepSimulation would hold it
+            // behind the state request and the zeroed latestBatchId).
+            resetAll();
+            resetPending = false;
+            dispatchBatch('reset', 0);
+        }
+        return;
+    }
+
+    if (type === 'snapshot') {
+        // Scatter the worker's field-major slice into the blob's full-width columns.
+        const local = new Float64Array(e.data.data);
+        const columns = stateRequest.columns;
+        const count = worker.systemIds.length;
+        const first = count > 0 ? worker.systemIds[0] : 0;
+        for (let f = 0; f < SYSTEM_STORE_FIELDS; f++) {
+            columns.set(local.subarray(f * count, (f + 1) * count), f * numSystems + first);
+        }
+        if (--stateRequest.pending === 0) finishStateRequest();
+        return;
+    }
+
+    if (type === 'restored') {
+        if (--stateRequest.pending === 0) publishRestore();
+    }
+}
+
+function completeMessageBatch(worker, buffer) {
+    // Always reclaim the worker's buffer (even for stale batches).
+    worker.bufferPool.push(buffer);
+
+    // Ignore stale responses (e.g., reset issued mid-update).
+    const header = new Float64Array(buffer, 0, BATCH_HEADER_DOUBLES);
+    const batchId = header[BATCH_ID];
+    if (batchId < resetBatchId) return;
+
+    const slot = batchId % SNAPSHOT_SLOTS;
+    readBatchOutput(worker, buffer, header, slot);
+    lastBatchLatency = performance.now() - slotDispatchTime[slot];
+    pushSample(worker.latency, lastBatchLatency);
+    pushSample(batchOutputBytes, header[BATCH_PAYLOAD_BYTES]);
+
+    completeWorkerBatch(batchId, header, BATCH_REDUCTION);
+}
+
+// Unpacks a worker's batch output (output-format.js) into the batch's ring slot.
+function readBatchOutput(worker, buffer, header, slot) {
+    const count = worker.systemIds.length;
+    const first = count > 0 ? worker.systemIds[0] : 0;
+    const values = batchOutput.names.length;
+    if (batchOutputIsState) {
+        snapshotRing.set(new Float32Array(buffer, BATCH_HEADER_BYTES, count * STATE_STRIDE), slot * snapshotFloats + first * STATE_STRIDE);
+        return;
+    }
+
+    const { encoding, quanta, wraps } = batchOutput;
+    const floats = encoding === 'float32' ? new Float32Array(buffer, BATCH_HEADER_BYTES, count * values) : null;
+    const int16 = encoding === 'int16' ? new Int16Array(buffer, BATCH_HEADER_BYTES, count * values) : null;
+    const bytes = encoding === 'delta' ? new Uint8Array(buffer, BATCH_HEADER_BYTES, header[BATCH_PAYLOAD_BYTES]) : null;
+    const previous = outputPrevious;
+    const unwrapped = outputUnwrapped;
+    if (header[BATCH_KEYFRAME] === 1 && !floats) {
+        previous.fill(0, first * values, (first + count) * values);
+        unwrapped.fill(0, first * values, (first + count) * values);
+    }
+    const ring = snapshotRing;
+    const base = slot * snapshotFloats;
+    const velocityBase = slot * numSystems * 2;
+    const targets = batchOutputTargets;
+    let p = 0;
+    for (let i = 0; i < count; i++) {
+        const id = first + i;
+        for (let v = 0; v < values; v++) {
+            let value;
+            if (floats) {
+                value = floats[i * values + v];
+            } else {
+                const k = id * values + v;
+                let q;
+                if (int16) {
+                    q = int16[i * values + v];
+                } else {
+                    let z = 0;
+                    let shift = 0;
+                    let b;
+                    do {
+                        b = bytes[p++];
+                        z |= (b & 127) << shift;
+                        shift += 7;
+                    } while (b & 128);
+                    q = ((previous[k] + ((z >>> 1) ^ -(z & 1))) << 16) >> 16;
+                }
+                if (wraps[v]) {
+                    unwrapped[k] += ((q - previous[k]) << 16) >> 16;
+                    value = unwrapped[k] * quanta[v];
+                } else {
+                    value = q * quanta[v];
+                }
+                previous[k] = q;
+            }
+            const t = targets[v];
+            if (t < STATE_STRIDE) ring[base + id * STATE_STRIDE + t] = value;
+            else velocityRing[velocityBase + id * 2 + t - STATE_STRIDE] = value;
+        }
+    }
+}
+
+// Ball velocities of the newest complete snapshot, [id * 2 + (vx, vy)], or null unless
+// message-mode batches carry them (?output=velocity).
+function latestVelocities() {
+    if (!velocityRing || latestBatchId === 0) return null;
+    const slot = latestBatchId % SNAPSHOT_SLOTS;
+    return velocityRing.subarray(slot * numSystems * 2, (slot + 1) * numSystems * 2);
+}
+
+// Bookkeeping shared by both exchange modes once a worker's slice of a batch is in
+// its ring slot, with its reduction record at reduction[at]. Workers run batches in order,
+// so batches also complete in order.
+function completeWorkerBatch(batchId, reduction, at) {
+    if (batchId < resetBatchId) return;
+
+    const slot = batchId % SNAPSHOT_SLOTS;
+    const sums = slot * REDUCTION_DOUBLES;
+    for (let k = R_SUM_X; k < REDUCTION_DOUBLES; k++) {
+        slotSums[sums + k] = k === R_MAX_SEPARATION
+            ? Math.max(slotSums[sums + k], reduction[at + k])
+            : slotSums[sums + k] + reduction[at + k];
+    }
+    const totalEnergy = reduction[at + R_ENERGY];
+    const sum = slotEnergy[slot];
+    const t = sum + totalEnergy;
+    slotEnergyCompensation[slot] += Math.abs(sum) >= Math.abs(totalEnergy) ? (sum - t) + totalEnergy : (totalEnergy - t) + sum;
+    slotEnergy[slot] = t;
+    if (--slotPending[slot] > 0) return;
+
+    displayedTotalEnergy = slotEnergy[slot] + slotEnergyCompensation[slot];
+    displayedSums.set(slotSums.subarray(sums, sums + REDUCTION_DOUBLES));
+    completedSteps += slotSteps[slot];
+    lastBatchLatency = performance.now() - slotDispatchTime[slot];
+    pushSample(poolLatency, lastBatchLatency);
+    simulationSteps = slotIsReset[slot] === SLOT_RESTORE ? restoredSteps
+        : slotIsReset[slot] === SLOT_RESET ? 0 : simulationSteps + slotSteps[slot];
+    if (slotIsReset[slot]) {
+        // Reset energy is the initial energy baseline; a restore brings its own.
+        totalInitialEnergy = slotIsReset[slot] === SLOT_RESTORE ? restoredInitialEnergy : displayedTotalEnergy;
+        // Prevent a "teleport" segment: drop any trail points sampled while reset was pending,
+        // and never interpolate across the reset.
+        clearTrails();
+        divergence.fill(0);
+        divergenceStep = 0;
+        previousBatchId = batchId;
+    } else {
+        previousBatchId = latestBatchId;
+    }
+    latestBatchId = batchId;
+    if (slotSums[sums + R_PAIRS] > 0) {
+        divergence.set(slotSums.subarray(sums, sums + REDUCTION_DOUBLES));
+        divergenceStep = simulationSteps;
+    }
+
+    // Dispatch keeps batch boundaries on every recorded step (see loop()).
+    if (recorder && simulationSteps % recorder.every === 0) recorder.record(simulationSteps, slotViews[slot]);
+}
+
+// Dispatches one batch: a reset, or `steps` consecutive steps of dt run inside each worker.
+// 'restore' publishes freshly restored stores: a zero-step update that completes like a reset.
+function dispatchBatch(type, dt, steps = 1) {
+    const batchId = ++activeBatchId;
+    const slot = batchId % SNAPSHOT_SLOTS;
+    const isReset = type === 'reset' || type === 'restore';
+    // Work-stealing batches complete once, when their last chunk is finished.
+    slotPending[slot] = useWorkStealing ? 1 : activeWorkers;
+    slotEnergy[slot] = 0;
+    slotEnergyCompensation[slot] = 0;
+    slotSums.fill(0, slot * REDUCTION_DOUBLES, (slot + 1) * REDUCTION_DOUBLES);
+    slotIsReset[slot] = type === 'reset' ? SLOT_RESET : type === 'restore' ? SLOT_RESTORE : 0;
+    slotSteps[slot] = isReset ? 0 : steps;
+    const firstStep = dispatchedSteps;
+    dispatchedSteps = type === 'reset' ? 0 : type === 'restore' ? restoredSteps : dispatchedSteps + steps;
+    slotDispatchTime[slot] = performance.now();
+    if (isReset) {
+        resetBatchId = batchId;
+        // The reset may reuse the previous snapshot's slot; show only the latest until it lands.
+        previousBatchId = latestBatchId;
+    }
+
+    const op = type === 'reset' ? OP_RESET : OP_UPDATE;
+    if (useSharedState) {
+        const commandByte = controlLayout.commandOffset + slot * controlLayout.commandBytes;
+        sharedControl[commandByte >> 2] = op;
+        sharedControl[(commandByte >> 2) + 1] = steps;
+        sharedControlF64[(commandByte >> 3) + 1] = dt;
+        sharedControlF64[(commandByte >> 3) + 2] = firstStep;
+        if (useWorkStealing) {
+            sharedControl[(controlLayout.claimOffset >> 2) + slot] = (batchId & CLAIM_TAG_MASK) << CLAIM_CHUNK_BITS;
+            sharedControl[(controlLayout.remainingOffset >> 2) + slot] = stealChunks;
+            for (let w = 0; w < numWorkers; w++) {
+                const reduction = reductionIndex(w, slot);
+                sharedControlF64.fill(0, reduction, reduction + REDUCTION_DOUBLES);
+            }
+        }
+        Atomics.store(sharedControl, controlLayout.seq, batchId);
+        Atomics.notify(sharedControl, controlLayout.seq);
+        if (useWorkStealing) {
+            watchStolenBatches();
+            return;
+        }
+        for (let w = 0; w < activeWorkers; w++) {
+            watchSharedWorker(workers[w]);
+        }
+        return;
+    }
+
+    // Workers past activeWorkers hold no systems and sit batches out.
+    for (let w = 0; w < activeWorkers; w++) {
+        const worker = workers[w];
+        const buffer = acquireWorkerBuffer(worker);
+        const header = new Float64Array(buffer, 0, BATCH_HEADER_DOUBLES);
+        header[BATCH_OP] = op;
+        header[BATCH_ID] = batchId;
+        header[BATCH_DT] = dt;
+        header[BATCH_STEPS] = steps;
+        header[BATCH_FIRST_STEP] = firstStep;
+        worker.transfer[0] = buffer;
+        worker.postMessage(buffer, worker.transfer);
+        worker.transfer[0] = null;
+    }
+}
+
+// Float64 index of worker w's reduction record for a ring slot in the shared control block.
+function reductionIndex(w, slot) {
+    return (controlLayout.reductionOffset >> 3) + (w * SNAPSHOT_SLOTS + slot) * REDUCTION_DOUBLES;
+}
+
+// Waits (without blocking) until the worker has published every dispatched batch.
+function watchSharedWorker(worker) {
+    if (worker.watching) return;
+    worker.watching = true;
+
+    const check = () => {
+        const done = Atomics.load(sharedControl, worker.doneIndex);
+        // Workers skip batches superseded by a reset, so jump straight past stale IDs.
+        for (let b = Math.max(worker.seenBatchId + 1, resetBatchId); b <= done; b++) {
+            lastBatchLatency = performance.now() - slotDispatchTime[b % SNAPSHOT_SLOTS];
+            pushSample(worker.latency, lastBatchLatency);
+            completeWorkerBatch(b, sharedControlF64, reductionIndex(worker.index, b % SNAPSHOT_SLOTS));
+        }
+        worker.seenBatchId = done;
+        if (done === activeBatchId) {
+            worker.watching = false;
+            return;
+        }
+        const result = Atomics.waitAsync(sharedControl, worker.doneIndex, done);
+        if (result.async) result.value.then(check);
+        else check();
+    };
+    check();
+}
+
+// Work-stealing counterpart of watchSharedWorker: one "batch done" word for the whole pool,
+// with each worker's share of the reductions in its own record.
+const stolenReduction = new Float64Array(REDUCTION_DOUBLES);
+function watchStolenBatches() {
+    if (stealWatching) return;
+    stealWatching = true;
+
+    const batchDoneIndex = controlLayout.batchDoneOffset >> 2;
+    const check = () => {
+        const done = Atomics.load(sharedControl, batchDoneIndex);
+        for (let b = stealSeenBatchId + 1; b <= done; b++) {
+            const slot = b % SNAPSHOT_SLOTS;
+            let sum = 0;
+            let compensation = 0;
+            stolenReduction.fill(0);
+            for (let w = 0; w < numWorkers; w++) {
+                const reduction = reductionIndex(w, slot);
+                const e = sharedControlF64[reduction + R_ENERGY];
+                const t = sum + e;
+                compensation += Math.abs(sum) >= Math.abs(e) ? (sum - t) + e : (e - t) + sum;
+                sum = t;
+                for (let k = R_SUM_X; k < REDUCTION_DOUBLES; k++) {
+                    const value = sharedControlF64[reduction + k];
+                    stolenReduction[k] = k === R_MAX_SEPARATION ? Math.max(stolenReduction[k], value) : stolenReduction[k] + value;
+                }
+            }
+            stolenReduction[R_ENERGY] = sum + compensation;
+            completeWorkerBatch(b, stolenReduction, 0);
+        }
+        stealSeenBatchId = done;
+        if (done === activeBatchId) {
+            stealWatching = false;
+            return;
+        }
+        const result = Atomics.waitAsync(sharedControl, batchDoneIndex, done);
+        if (result.async) result.value.then(check);
+        else check();
+    };
+    check();
+}
+
+// Points stateView at the two newest complete snapshots, t in [0, 1]. The newest slot is
+// only rewritten once PIPELINE_DEPTH newer batches have completed, so it can be viewed
+// without a copy for the rest of the frame.
+function interpolateSnapshots(t) {
+    if (latestBatchId === 0) return;
+    const to = latestBatchId % SNAPSHOT_SLOTS;
+    const from = previousBatchId % SNAPSHOT_SLOTS;
+    if (from === to || t >= 1) {
+        stateView = slotViews[to];
+        return;
+    }
+    const a = slotViews[from];
+    const b = slotViews[to];
+    const out = interpolatedState;
+    for (let k = 0; k < snapshotFloats; k++) {
+        const v = a[k];
+        out[k] = v + (b[k] - v) * t;
+    }
+    stateView = out;
+}
+
+function lerp(a, b, t) {
+    return a + (b - a) * t;
+}
+
+function clearTrails() {
+    if (glRenderer) {
+        glRenderer.clearTrails();
+        return;
+    }
+    trailLayersT = -1;
+    tilesT = -1;
+    densityActive = false;
+    trailHead = 0;
+    trailSize = 0;
+}
+
+// Appends every system's current ball position to its trail.
+function pushTrailPoints() {
+    const head = trailHead;
+    for (let i = 0, k = head; i < numSystems; i++, k += TRAIL_LENGTH) {
+        const base = i * STATE_STRIDE;
+        trailX[k] = stateView[base];
+        trailY[k] = stateView[base + 1];
+    }
+
+    const nextHead = head + 1;
+    trailHead = nextHead === TRAIL_LENGTH ? 0 : nextHead;
+    if (trailSize < TRAIL_LENGTH) trailSize++;
+}
+
+function resize() {
+    const view = host.viewport();
+    canvas.width = view.width;
+    canvas.height = view.height;
+    
+    graphCanvas.width = view.graphWidth;
+    graphCanvas.height = view.graphHeight;
+
+    if (ringLayer) {
+        ringLayer.width = canvas.width;
+        ringLayer.height = canvas.height;
+        ringLayerT = -1;
+    }
+    for (const layer of trailLayers) {
+        layer.canvas.width = canvas.width;
+        layer.canvas.height = canvas.height;
+    }
+    trailLayersT = -1;
+    densityActive = false;
+    
+    resizeEnergyHistory(graphCanvas.width);
+    
+    cellW = canvas.width / gridCols;
+    cellH = canvas.height / gridRows;
+    overlayCenterX = canvas.width * 0.5;
+    overlayCenterY = canvas.height * 0.5;
+
+    for (let i = 0; i < numSystems; i++) {
+        const col = i % gridCols;
+        const row = (i / gridCols) | 0;
+        gridCx[i] = col * cellW + cellW * 0.5;
+        gridCy[i] = row * cellH + cellH * 0.5;
+    }
+
+    const cellUnitSize = (CONTAINER_RADIUS * 2) * 1.1;
+    
+    const scaleH = canvas.height / (gridRows * cellUnitSize);
+    const scaleW = canvas.width / (gridCols * cellUnitSize);
+    layoutScale = Math.min(scaleH, scaleW) * 0.95;
+    
+    const overlayUnitSize = (CONTAINER_RADIUS * 2) * 1.05;
+    const overlayScaleH = canvas.height / overlayUnitSize;
+    const overlayScaleW = canvas.width / overlayUnitSize;
+    overlayScale = Math.min(overlayScaleH, overlayScaleW) * 0.98;
+
+    layoutTiles();
+}
+
+// Groups the grid cells into tiles of about TILE_PX and marks every tile stale.
+function layoutTiles() {
+    tileCellCols = Math.min(gridCols, Math.max(1, Math.round(TILE_PX / cellW)));
+    tileCellRows = Math.min(gridRows, Math.max(1, Math.round(TILE_PX / cellH)));
+    tileCols = Math.ceil(gridCols / tileCellCols);
+    tileRows = Math.ceil(gridRows / tileCellRows);
+    const count = tileCols * tileRows;
+
+    systemTile = new Int32Array(numSystems);
+    for (let i = 0; i < numSystems; i++) {
+        const col = i % gridCols;
+        const row = (i / gridCols) | 0;
+        systemTile[i] = ((row / tileCellRows) | 0) * tileCols + ((col / tileCellCols) | 0);
+    }
+    tileChange = new Float32Array(count);
+    tileAge = new Uint32Array(count);
+    tileStale = new Uint8Array(count);
+    tilePriority = new Float64Array(count);
+    tileOrder = new Int32Array(count);
+    tileDrawn = new Float32Array(numSystems * TILE_DRAWN_STRIDE);
+    tilesT = -1;
+}
+
+// Resolves with a snapshot blob (see SNAPSHOT_MAGIC) of the multiverse as of the newest
+// dispatched batch.
+function snapshotMultiverse() {
+    return requestState({ kind: 'snapshot', blob: null });
+}
+
+// Replaces the whole multiverse with a snapshot blob, resizing first if its system count
+// differs. Stepping resumes from the restored state and step count.
+function restoreMultiverse(blob) {
+    const header = new DataView(blob);
+    if (blob.byteLength < SNAPSHOT_HEADER_BYTES || header.getUint32(0, true) !== SNAPSHOT_MAGIC) {
+        return Promise.reject(new Error('Not a multiverse snapshot'));
+    }
+    const fields = header.getUint16(6, true);
+    const count = header.getUint32(8, true);
+    if (header.getUint16(4, true) !== SNAPSHOT_VERSION || fields !== SYSTEM_STORE_FIELDS ||
+        count < 1 || count > MAX_NUM_SYSTEMS ||
+        blob.byteLength !== SNAPSHOT_HEADER_BYTES + fields * count * 8) {
+        return Promise.reject(new Error('Unsupported snapshot layout'));
+    }
+    return requestState({ kind: 'restore', blob });
+}
+
+function requestState(request) {
+    if (!isReady || stateRequest) {
+        return Promise.reject(new Error('Snapshot or restore unavailable right now'));
+    }
+    return new Promise((resolve, reject) => {
+        stateRequest = { ...request, resolve, reject, started: false, pending: 0, columns: null };
+    });
+}
+
+// Runs once the pipeline has drained. Work-stealing stores live in shared memory, so the
+// page reads and writes them directly; otherwise every worker exchanges its slice.
+function beginStateRequest() {
+    const request = stateRequest;
+
+    if (request.kind === 'snapshot') {
+        request.blob = new ArrayBuffer(SNAPSHOT_HEADER_BYTES + SYSTEM_STORE_FIELDS * numSystems * 8);
+        const header = new DataView(request.blob);
+        header.setUint32(0, SNAPSHOT_MAGIC, true);
+        header.setUint16(4, SNAPSHOT_VERSION, true);
+        header.setUint16(6, SYSTEM_STORE_FIELDS, true);
+        header.setUint32(8, numSystems, true);
+        header.setFloat64(16, simulationSteps, true);
+        header.setFloat64(24, FIXED_DT, true);
+        request.columns = new Float64Array(request.blob, SNAPSHOT_HEADER_BYTES);
+        request.started = true;
+        if (useWorkStealing) {
+            request.columns.set(new Float64Array(sharedStoreBuffer));
+            finishStateRequest();
+            return;
+        }
+        request.pending = numWorkers;
+        workers.forEach((worker) => worker.postMessage({ type: 'snapshot' }));
+        return;
+    }
+
+    const header = new DataView(request.blob);
+    const count = header.getUint32(8, true);
+    if (count !== numSystems) {
+        // The resize ends in a reset; the restore starts once that has drained.
+        applySystemCount(count);
+        return;
+    }
+    if (request.activeWorkers !== undefined && request.activeWorkers !== activeWorkers) {
+        // Nothing is in flight, so the new slices need no reset before the restore.
+        activeWorkers = request.activeWorkers;
+        showWorkerCount();
+        request.repartitioning = true;
+        resizePending = numWorkers;
+        partitionWorkers('resize');
+        return;
+    }
+
+    request.started = true;
+    restoredSteps = header.getFloat64(16, true);
+    const columns = new Float64Array(request.blob, SNAPSHOT_HEADER_BYTES);
+    const initialEnergy = columns.subarray(STORE_INITIAL_ENERGY_FIELD * count, (STORE_INITIAL_ENERGY_FIELD + 1) * count);
+    restoredInitialEnergy = 0;
+    for (let i = 0; i < count; i++) restoredInitialEnergy += initialEnergy[i];
+    // A snapshot carries its own physics constants; draw its ball radii.
+    const radii = columns.subarray(STORE_BALL_RADIUS_FIELD * count, (STORE_BALL_RADIUS_FIELD + 1) * count);
+    ballRadii = radii.every((r) => r === BALL_RADIUS) ? null : Float32Array.from(radii);
+    if (glRenderer) glRenderer.setBallRadii(ballRadii);
+
+    if (useWorkStealing) {
+        new Float64Array(sharedStoreBuffer).set(columns);
+        publishRestore();
+        return;
+    }
+    request.pending = numWorkers;
+    for (const worker of workers) {
+        const local = worker.systemIds.length;
+        const first = local > 0 ? worker.systemIds[0] : 0;
+        const slice = new Float64Array(SYSTEM_STORE_FIELDS * local);
+        for (let f = 0; f < SYSTEM_STORE_FIELDS; f++) {
+            slice.set(columns.subarray(f * count + first, f * count + first + local), f * local);
+        }
+        worker.postMessage({ type: 'restore', data: slice.buffer }, [slice.buffer]);
+    }
+}
+
+// Moves the multiverse onto `count` workers without disturbing it: a snapshot, then a
+// restore that repartitions first. Per-system stepping does not depend on the partition,
+// so the run continues exactly.
+function setActiveWorkers(count) {
+    count = Math.max(1, Math.min(numWorkers, count));
+    if (count === activeWorkers) return Promise.resolve();
+    return snapshotMultiverse().then((blob) => requestState({ kind: 'restore', blob, activeWorkers: count }));
+}
+
+// Power policy input: the host's { onBattery, pressure } report (pressure is a Compute
+// Pressure state: nominal, fair, serious or critical).
+function applyPowerState({ onBattery = false, pressure = 'nominal' } = {}) {
+    powerConstrained = powerPolicy === 'auto' && (onBattery || pressure === 'serious' || pressure === 'critical');
+    updateWantedWorkers();
+}
+
+function updateWantedWorkers() {
+    const size = calibration ? calibratedPoolSize() : numWorkers;
+    wantedWorkers = powerConstrained ? Math.ceil(size / 2) : size;
+}
+
+// A batch of S steps over N systems on k workers costs about m k + c S N / k: one message
+// exchange per worker (m, serialised on the page) plus the stepping split k ways (c per
+// system-step), so the best k is sqrt(c S N / m) for this frame's usual S.
+function calibratedPoolSize() {
+    const { messageMs, systemStepMs } = calibration;
+    const k = Math.round(Math.sqrt(systemStepMs * STEPS_PER_FRAME * numSystems / Math.max(messageMs, 1e-3)));
+    return Math.max(1, Math.min(numWorkers, k));
+}
+
+// Runs once the whole pool is up, on the last worker (idle during the warm start): ping
+// round trips for m, then a timed run of a scratch store for c (see calibratedPoolSize).
+function calibratePool() {
+    calibration = null;
+    if (poolPolicy !== 'auto' || numWorkers === 1) {
+        poolSized = true;
+        updateWantedWorkers();
+        return;
+    }
+    const worker = workers[numWorkers - 1];
+    const pings = [];
+    worker.onpong = (sentAt) => {
+        pings.push(performance.now() - sentAt);
+        if (pings.length < CALIBRATION_PINGS) {
+            worker.postMessage({ type: 'ping', sentAt: performance.now() });
+            return;
+        }
+        worker.onpong = null;
+        worker.postMessage({ type: 'calibrate', systems: CALIBRATION_SYSTEMS, steps: CALIBRATION_STEPS });
+    };
+    worker.oncalibrated = (systemStepMs) => {
+        worker.oncalibrated = null;
+        pings.sort((a, b) => a - b);
+        calibration = { messageMs: pings[pings.length >> 1], systemStepMs };
+        poolSized = true;
+        updateWantedWorkers();
+    };
+    worker.postMessage({ type: 'ping', sentAt: performance.now() });
+}
+
+// Page Visibility: see backgroundPolicy.
+function setPageVisible(visible) {
+    if (visible === !pageHidden) return;
+    const now = performance.now();
+    pageHidden = !visible;
+    if (pageHidden) {
+        hiddenSince = now;
+        if (backgroundPolicy === 'full') {
+            lastTime = now;
+            backgroundTimer = setTimeout(backgroundTick, BACKGROUND_TICK_MS);
+        }
+        return;
+    }
+
+    clearTimeout(backgroundTimer);
+    backgroundTimer = null;
+    if (backgroundPolicy === 'catchup') {
+        catchUpSteps += Math.floor(Math.min((now - hiddenSince) / 1000, CATCHUP_MAX_SECONDS) / FIXED_DT);
+    }
+    lastTime = now;
+    if (isReady && !loopRunning) {
+        loopRunning = true;
+        requestFrame(loop);
+    }
+}
+
+// Stepping for a hidden page under ?background=full.
+function backgroundTick() {
+    backgroundTimer = setTimeout(backgroundTick, BACKGROUND_TICK_MS);
+    const now = performance.now();
+    const frameTime = (now - lastTime) / 1000;
+    lastTime = now;
+    if (!isReady) return;
+    stepSimulation(frameTime, PIPELINE_DEPTH * BACKGROUND_MAX_STEPS_PER_BATCH * FIXED_DT, BACKGROUND_MAX_STEPS_PER_BATCH);
+}
+
+function publishRestore() {
+    lastUiUpdate = 0;
+    clearEnergyHistory();
+    dispatchBatch('restore', 0, 0);
+    finishStateRequest();
+}
+
+function finishStateRequest() {
+    const { kind, blob, resolve } = stateRequest;
+    stateRequest = null;
+    resolve(kind === 'snapshot' ? blob : undefined);
+}
+
+function resetAll() {
+    // Clear trails/history immediately (don't wait for worker replies).
+    clearTrails();
+    lastUiUpdate = 0;
+
+    resetPending = true;
+    clearEnergyHistory();
+}
+
+function clearEnergyHistory() {
+    energyHistoryHead = 0;
+    energyHistorySize = 0;
+    graphScroll = 0;
+    graphStale = true;
+}
+
+// Keeps the newest samples that still fit a graph `width` columns wide.
+function resizeEnergyHistory(width) {
+    const old = energyHistory;
+    const size = Math.min(energyHistorySize, width);
+    energyHistory = new Float64Array(width);
+    for (let k = 0; k < size; k++) {
+        energyHistory[k] = old[(energyHistoryHead - size + k + old.length) % old.length];
+    }
+    energyHistoryHead = size === width ? 0 : size;
+    energyHistorySize = size;
+    graphStale = true;
+}
+
+function graphY(total, h) {
+    const scale = 5000;
+    const diff = (total - totalInitialEnergy) / totalInitialEnergy;
+    return (h/2) - (diff * (h/2) * scale);
+}
+
+// Dashed zero line over columns [x0, x1), phased by graphScroll so scrolled pieces line up.
+function drawGraphBaseline(x0, x1, h) {
+    graphCtx.beginPath();
+    graphCtx.strokeStyle = '#444';
+    graphCtx.lineWidth = 1;
+    graphCtx.setLineDash([5, 5]);
+    graphCtx.lineDashOffset = graphScroll + x0;
+    graphCtx.moveTo(x0, h/2);
+    graphCtx.lineTo(x1, h/2);
+    graphCtx.stroke();
+    graphCtx.setLineDash([]);
+    graphCtx.lineDashOffset = 0;
+}
+
+function drawEnergyGraph() {
+    const w = graphCanvas.width;
+    const h = graphCanvas.height;
+    graphCtx.clearRect(0, 0, w, h);
+    drawGraphBaseline(0, w, h);
+
+    graphCtx.beginPath();
+    graphCtx.strokeStyle = '#0f0';
+    graphCtx.lineWidth = 2;
+    const first = energyHistorySize === w ? energyHistoryHead : 0;
+    for (let i = 0; i < energyHistorySize; i++) {
+        const y = graphY(energyHistory[(first + i) % w], h);
+        if(i===0) graphCtx.moveTo(i, y);
+        else graphCtx.lineTo(i, y);
+    }
+    graphCtx.stroke();
+}
+
+function updateGraph(currentTotal) {
+    if (!totalInitialEnergy) return;
+    const w = graphCanvas.width;
+    const h = graphCanvas.height;
+    if (w === 0) return;
+
+    const scrolls = energyHistorySize === w;
+    const previous = energyHistory[(energyHistoryHead + w - 1) % w];
+    energyHistory[energyHistoryHead] = currentTotal;
+    energyHistoryHead = energyHistoryHead + 1 === w ? 0 : energyHistoryHead + 1;
+    if (!scrolls) energyHistorySize++;
+    if (scrolls) graphScroll++;
+
+    if (graphStale) {
+        graphStale = false;
+        drawEnergyGraph();
+        return;
+    }
+
+    // Newest sample sits at column size - 1; a full graph moves everything left first.
+    const x = energyHistorySize - 1;
+    if (scrolls) {
+        graphCtx.globalCompositeOperation = 'copy';
+        graphCtx.drawImage(graphCanvas, -1, 0);
+        graphCtx.globalCompositeOperation = 'source-over';
+        drawGraphBaseline(x, w, h);
+    }
+    if (x === 0) return;
+    graphCtx.beginPath();
+    graphCtx.strokeStyle = '#0f0';
+    graphCtx.lineWidth = 2;
+    graphCtx.moveTo(x - 1, graphY(previous, h));
+    graphCtx.lineTo(x, graphY(currentTotal, h));
+    graphCtx.stroke();
+}
+
+// Adds frameTime of real time to the step debt and dispatches it, plus any catch-up
+// steps. Returns frameTime capped to maxFrameTime.
+function stepSimulation(frameTime, maxFrameTime, maxStepsPerBatch) {
+    if (frameTime > maxFrameTime) {
+        droppedSteps += (frameTime - maxFrameTime) / FIXED_DT;
+        frameTime = maxFrameTime;
+    }
+    
+    accumulator += frameTime;
+    // Workers that can't keep up leave debt behind; cap it like a long frame.
+    if (accumulator > maxFrameTime) {
+        droppedSteps += (accumulator - maxFrameTime) / FIXED_DT;
+        accumulator = maxFrameTime;
+    }
+    
+    // A reset takes a ring slot like any batch, so it waits for pipeline room too; any
+    // resets requested meanwhile coalesce into it, and no updates go out ahead of it.
+    if (resetPending && !stateRequest && activeBatchId - latestBatchId < PIPELINE_DEPTH) {
+        resetPending = false;
+        dispatchBatch('reset', 0);
+    }
+
+    // Coalesce the step debt into batches, keeping up to PIPELINE_DEPTH in flight
+    // (a pending reset counts against the depth).
+    while (!stateRequest && !resetPending && accumulator >= FIXED_DT && activeBatchId - latestBatchId < PIPELINE_DEPTH) {
+        let steps = Math.min(Math.floor(accumulator / FIXED_DT), maxStepsPerBatch);
+        // A recording needs a published state on each of its steps; end the batch there.
+        if (recorder) steps = Math.min(steps, recorder.every - dispatchedSteps % recorder.every);
+        dispatchBatch('update', FIXED_DT, steps);
+        accumulator -= steps * FIXED_DT;
+    }
+    // Hidden time being caught up takes whatever pipeline room is left.
+    while (!stateRequest && !resetPending && catchUpSteps > 0 && activeBatchId - latestBatchId < PIPELINE_DEPTH) {
+        let steps = Math.min(catchUpSteps, catchUpBatchSteps);
+        if (recorder) steps = Math.min(steps, recorder.every - dispatchedSteps % recorder.every);
+        dispatchBatch('update', FIXED_DT, steps);
+        catchUpSteps -= steps;
+    }
+    if (stateRequest && !stateRequest.started && resizePending === 0 && latestBatchId === activeBatchId) {
+        beginStateRequest();
+    } else if (!stateRequest && resizePending === 0 && poolSized && wantedWorkers !== activeWorkers) {
+        setActiveWorkers(wantedWorkers).catch((err) => console.warn(err.message));
+    }
+    return frameTime;
+}
+
+// Back-pressure on catch-up batches from the frame time and the newest batch latency.
+function adaptCatchUp(frameMs) {
+    const batchMs = lastBatchLatency;
+    if (frameMs > CATCHUP_FRAME_BUDGET_MS || batchMs > CATCHUP_BATCH_BUDGET_MS) {
+        catchUpBatchSteps = Math.max(MAX_STEPS_PER_BATCH, catchUpBatchSteps >> 1);
+    } else if (frameMs < CATCHUP_FRAME_BUDGET_MS / 2 && batchMs < CATCHUP_BATCH_BUDGET_MS / 2) {
+        catchUpBatchSteps = Math.min(CATCHUP_MAX_STEPS_PER_BATCH, catchUpBatchSteps * 2);
+    }
+}
+
+function loop() {
+    // A hidden page schedules no frames; setPageVisible restarts the loop.
+    if (pageHidden) {
+        loopRunning = false;
+        return;
+    }
+    const currentTime = performance.now();
+    let frameTime = (currentTime - lastTime) / 1000;
+    lastTime = currentTime;
+    pushSample(frameTimes, frameTime * 1000);
+    if (catchUpSteps > 0) adaptCatchUp(frameTime * 1000);
+    frameTime = stepSimulation(frameTime, MAX_FRAME_TIME, MAX_STEPS_PER_BATCH);
+
+    // Render between the two newest complete snapshots by the leftover fraction of the
+    // newest batch's span.
+    const latestSteps = slotSteps[latestBatchId % SNAPSHOT_SLOTS];
+    interpolateSnapshots(latestSteps > 0 ? Math.min(accumulator / (latestSteps * FIXED_DT), 1) : 1);
+    
+    const transitionSpeed = 5.0;
+    const targetTransition = showOverlay ? 1 : 0;
+    overlayTransition = lerp(overlayTransition, targetTransition, frameTime * transitionSpeed);
+    // The exponential approach never lands exactly; snap so cached layers can settle.
+    if (Math.abs(overlayTransition - targetTransition) < 0.001) overlayTransition = targetTransition;
+    
+    if ((currentTime - lastUiUpdate) >= UI_UPDATE_INTERVAL_MS) {
+        lastUiUpdate = currentTime;
+
+        if (showOverlay) {
+            // Summed by the workers with each batch (see completeWorkerBatch).
+            const invCount = 1 / numSystems;
+            host.ui.text('avg-x', (displayedSums[R_SUM_X] * invCount).toFixed(1));
+            host.ui.text('avg-y', (displayedSums[R_SUM_Y] * invCount).toFixed(1));
+            host.ui.text('avg-dist', (displayedSums[R_SUM_DIST] * invCount).toFixed(1));
+            if (analyticsEvery > 0) updateDivergenceStats();
+        }
+
+        host.ui.text('total-e', (displayedTotalEnergy / 1000).toFixed(1) + "k");
+
+        const dev = totalInitialEnergy > 0 ? ((displayedTotalEnergy - totalInitialEnergy) / totalInitialEnergy) * 100 : 0;
+        const devDisplay = Math.abs(dev) < 0.001 ? "0.00" : (dev > 0 ? "+" : "") + dev.toPrecision(3);
+        host.ui.text('deviation', devDisplay + "%");
+
+        updateGraph(displayedTotalEnergy);
+    }
+
+    if ((currentTime - lastPerfUpdate) >= PERF_UPDATE_INTERVAL_MS) {
+        updatePerfStats(currentTime);
+    }
+
+    if (glRenderer) drawFrameGl(overlayTransition);
+    else drawFrame2d(overlayTransition);
+
+    host.ui.commit();
+    requestFrame(loop);
+}
+
+// Canvas2D renderer: three passes of per-system paths, t = overlay transition. Large
+// settled grids are drawn tile by tile instead (drawTiles).
+function drawFrame2d(t) {
+    const systemScale = lerp(layoutScale, overlayScale, t);
+
+    // Level of detail from the on-screen container radius.
+    const radiusPx = CONTAINER_RADIUS * systemScale;
+    const detail = radiusPx >= LOD_DETAIL_PX;
+    const points = radiusPx < LOD_POINT_PX;
+    const density = t === 1 && numSystems >= DENSITY_MIN_SYSTEMS && densityCanvas !== null;
+
+    // Precompute per-system draw positions for this frame (avoid per-pass recalculation/allocations),
+    // culling containers that fall entirely outside the canvas.
+    const margin = radiusPx + 2;
+    const maxX = canvas.width + margin;
+    const maxY = canvas.height + margin;
+    for (let i = 0; i < numSystems; i++) {
+        const cx = lerp(gridCx[i], overlayCenterX, t);
+        const cy = lerp(gridCy[i], overlayCenterY, t);
+        drawCx[i] = cx;
+        drawCy[i] = cy;
+        drawVisible[i] = cx > -margin && cx < maxX && cy > -margin && cy < maxY ? 1 : 0;
+    }
+
+    if (t === 0 && (tileMode === 'on' || (tileMode === 'auto' && numSystems >= TILED_MIN_SYSTEMS))) {
+        drawTiles(systemScale, detail, points);
+        return;
+    }
+    tilesT = -1;
+
+    // Pass 1: Draw all container circles and crosshairs. Once the overlay transition has
+    // settled the background and rings come from the cached layer; crosshairs need detail.
+    let passStart = performance.now();
+    const ringsCached = ringLayerCtx !== null && (t === 0 || t === 1);
+    if (ringsCached) {
+        if (ringLayerT !== t) drawRingLayer(t, systemScale);
+        ctx.drawImage(ringLayer, 0, 0);
+    } else {
+        ctx.fillStyle = '#222';
+        ctx.fillRect(0, 0, canvas.width, canvas.height);
+    }
+
+    ctx.globalAlpha = lerp(1.0, overlayAlpha, t);
+
+    if (!ringsCached || detail) drawContainers(0, numSystems, systemScale, !ringsCached, detail);
+
+    let passEnd = performance.now();
+    pushSample(renderPassTimes[0], passEnd - passStart);
+    passStart = passEnd;
+
+    // Pass 2: Draw all trails (a density map in a crowded overlay, nothing at dot size)
+    if (showTrails) {
+        pushTrailPoints();
+
+        if (density) {
+            drawDensity(systemScale);
+        } else if (!points) {
+            if (trailLayers.length > 0 && (t === 0 || t === 1)) {
+                drawTrailsIncremental(t, systemScale);
+            } else {
+                for (let i = 0; i < numSystems; i++) {
+                    if (drawVisible[i] === 1) strokeTrail(ctx, i, systemScale);
+                }
+            }
+        }
+    }
+    densityActive = showTrails && density;
+
+    passEnd = performance.now();
+    pushSample(renderPassTimes[1], passEnd - passStart);
+    passStart = passEnd;
+
+    // Pass 3: Draw all balls
+    drawBalls(0, numSystems, systemScale, detail, points);
+
+    pushSample(renderPassTimes[2], performance.now() - passStart);
+
+    ctx.setTransform(1, 0, 0, 1, 0, 0);
+    ctx.globalAlpha = 1.0;
+}
+
+// Container rings (unless cached) and, at detail, crosshairs of systems [begin, end).
+function drawContainers(begin, end, systemScale, rings, detail) {
+    for (let i = begin; i < end; i++) {
+        if (drawVisible[i] === 0) continue;
+        ctx.setTransform(systemScale, 0, 0, systemScale, drawCx[i], drawCy[i]);
+
+        if (rings) {
+            ctx.beginPath();
+            ctx.arc(0, 0, CONTAINER_RADIUS, 0, TWO_PI);
+            ctx.lineWidth = 4;
+            ctx.strokeStyle = '#555';
+            ctx.stroke();
+        }
+        if (!detail) continue;
+
+        ctx.rotate(stateView[i * STATE_STRIDE + 3]);
+        ctx.strokeStyle = '#333';
+        ctx.lineWidth = 2;
+        ctx.beginPath();
+        ctx.moveTo(-CONTAINER_RADIUS, 0);
+        ctx.lineTo(CONTAINER_RADIUS, 0);
+        ctx.moveTo(0, -CONTAINER_RADIUS);
+        ctx.lineTo(0, CONTAINER_RADIUS);
+        ctx.stroke();
+    }
+}
+
+// Balls of systems [begin, end): orientation lines need detail; tiny cells get square dots.
+function drawBalls(begin, end, systemScale, detail, points) {
+    ctx.fillStyle = '#eee';
+    ctx.strokeStyle = '#000';
+    ctx.lineWidth = 3;
+
+    if (points) {
+        ctx.setTransform(1, 0, 0, 1, 0, 0);
+        for (let i = begin; i < end; i++) {
+            if (drawVisible[i] === 0) continue;
+            const base = i * STATE_STRIDE;
+            const size = Math.max(1, (ballRadii ? ballRadii[i] : BALL_RADIUS) * 2 * systemScale);
+            const half = size * 0.5;
+            ctx.fillRect(drawCx[i] + stateView[base] * systemScale - half,
+                drawCy[i] + stateView[base + 1] * systemScale - half, size, size);
+        }
+        return;
+    }
+    for (let i = begin; i < end; i++) {
+        if (drawVisible[i] === 0) continue;
+        const base = i * STATE_STRIDE;
+        ctx.setTransform(systemScale, 0, 0, systemScale, drawCx[i], drawCy[i]);
+        ctx.translate(stateView[base], stateView[base + 1]);
+        ctx.rotate(stateView[base + 2]);
+        const radius = ballRadii ? ballRadii[i] : BALL_RADIUS;
+
+        ctx.beginPath();
+        ctx.arc(0, 0, radius, 0, TWO_PI);
+        ctx.fill();
+
+        if (!detail) continue;
+        ctx.beginPath();
+        ctx.moveTo(0, 0);
+        ctx.lineTo(radius, 0);
+        ctx.stroke();
+    }
+}
+
+// Tiled grid (see TILE_PX). Stale tiles go first, in order; then changed tiles by px
+// moved times frames waited, so small changes still get their turn. Each further tile
+// must fit the budget at the running per-system cost; at least one is drawn per frame.
+const tilePassMs = new Float64Array(3);
+const compareTiles = (a, b) => (tileStale[b] - tileStale[a]) || (tilePriority[b] - tilePriority[a]);
+function drawTiles(systemScale, detail, points) {
+    const frameStart = performance.now();
+    const trails = showTrails && !points;
+    if (showTrails) pushTrailPoints();
+    densityActive = false;
+    trailLayersT = -1;
+
+    ctx.setTransform(1, 0, 0, 1, 0, 0);
+    ctx.globalAlpha = 1.0;
+    if (ringLayerCtx !== null && ringLayerT !== 0) {
+        drawRingLayer(0, systemScale);
+        tilesT = -1;
+    }
+    if (tilesT !== 0) {
+        // The canvas holds another layout: clear it (to the bare rings, when cached).
+        if (ringLayerCtx !== null) {
+            ctx.drawImage(ringLayer, 0, 0);
+        } else {
+            ctx.fillStyle = '#222';
+            ctx.fillRect(0, 0, canvas.width, canvas.height);
+        }
+        tileStale.fill(1);
+        tilesT = 0;
+    }
+
+    // Visible change since each system was drawn: ball travel and, at detail, the
+    // orientation line and crosshair ends; with trails, the tail point as well.
+    tileChange.fill(0);
+    const drawn = tileDrawn;
+    let tail = trailHead - trailSize;
+    if (tail < 0) tail += TRAIL_LENGTH;
+    for (let i = 0; i < numSystems; i++) {
+        const base = i * STATE_STRIDE;
+        const d = i * TILE_DRAWN_STRIDE;
+        let change = Math.max(Math.abs(stateView[base] - drawn[d]), Math.abs(stateView[base + 1] - drawn[d + 1]));
+        if (detail) {
+            const radius = ballRadii ? ballRadii[i] : BALL_RADIUS;
+            change = Math.max(change, Math.abs(stateView[base + 2] - drawn[d + 2]) * radius,
+                Math.abs(stateView[base + 3] - drawn[d + 3]) * CONTAINER_RADIUS);
+        }
+        if (trails && trailSize > 0) {
+            const k = i * TRAIL_LENGTH + tail;
+            change = Math.max(change, Math.abs(trailX[k] - drawn[d + 4]), Math.abs(trailY[k] - drawn[d + 5]));
+        }
+        change *= systemScale;
+        const k = systemTile[i];
+        if (change > tileChange[k]) tileChange[k] = change;
+    }
+
+    let candidates = 0;
+    for (let k = 0; k < tileChange.length; k++) {
+        tileAge[k]++;
+        if (tileStale[k] === 0 && tileChange[k] < TILE_CHANGE_PX) continue;
+        tilePriority[k] = tileStale[k] === 1 ? -k : tileChange[k] * tileAge[k];
+        tileOrder[candidates++] = k;
+    }
+    const order = tileOrder.subarray(0, candidates).sort(compareTiles);
+
+    tilePassMs.fill(0);
+    tilePassMs[0] = performance.now() - frameStart;
+    const tileSystems = tileCellCols * tileCellRows;
+    let drawnTiles = 0;
+    for (let n = 0; n < candidates; n++) {
+        const elapsed = performance.now() - frameStart;
+        if (drawnTiles > 0 && elapsed + tileCostMs * tileSystems > tileBudgetMs) break;
+        const tileStart = performance.now();
+        const systems = drawTile(order[n], systemScale, detail, trails, points, tail);
+        const perSystem = (performance.now() - tileStart) / Math.max(1, systems);
+        tileCostMs = tileCostMs > 0 ? 0.9 * tileCostMs + 0.1 * perSystem : perSystem;
+        drawnTiles++;
+    }
+    tilesDrawn = drawnTiles;
+    tilesPending = candidates - drawnTiles;
+
+    for (let p = 0; p < 3; p++) pushSample(renderPassTimes[p], tilePassMs[p]);
+    ctx.setTransform(1, 0, 0, 1, 0, 0);
+    ctx.globalAlpha = 1.0;
+}
+
+// Redraws tile k clipped to its cells (background and rings, from the ring layer when
+// there is one, then crosshairs, trails and balls) and records what it now shows. Returns
+// the number of systems drawn.
+function drawTile(k, systemScale, detail, trails, points, tail) {
+    const col0 = (k % tileCols) * tileCellCols;
+    const col1 = Math.min(gridCols, col0 + tileCellCols);
+    const row0 = ((k / tileCols) | 0) * tileCellRows;
+    const row1 = Math.min(gridRows, row0 + tileCellRows);
+    const x0 = Math.round(col0 * cellW);
+    const y0 = Math.round(row0 * cellH);
+    const w = Math.round(col1 * cellW) - x0;
+    const h = Math.round(row1 * cellH) - y0;
+
+    let passStart = performance.now();
+    ctx.save();
+    ctx.beginPath();
+    ctx.rect(x0, y0, w, h);
+    ctx.clip();
+    const ringsCached = ringLayerCtx !== null;
+    if (ringsCached) {
+        ctx.drawImage(ringLayer, x0, y0, w, h, x0, y0, w, h);
+    } else {
+        ctx.fillStyle = '#222';
+        ctx.fillRect(x0, y0, w, h);
+    }
+    let systems = 0;
+    for (let row = row0; row < row1; row++) {
+        const begin = row * gridCols + col0;
+        if (begin >= numSystems) break;
+        const end = Math.min(numSystems, row * gridCols + col1);
+        if (!ringsCached || detail) drawContainers(begin, end, systemScale, !ringsCached, detail);
+        systems += end - begin;
+    }
+    let passEnd = performance.now();
+    tilePassMs[0] += passEnd - passStart;
+    passStart = passEnd;
+
+    for (let row = row0; row < row1 && trails; row++) {
+        const begin = row * gridCols + col0;
+        const end = Math.min(numSystems, row * gridCols + col1);
+        for (let i = begin; i < end; i++) {
+            if (drawVisible[i] === 1) strokeTrail(ctx, i, systemScale);
+        }
+    }
+    passEnd = performance.now();
+    tilePassMs[1] += passEnd - passStart;
+    passStart = passEnd;
+
+    for (let row = row0; row < row1; row++) {
+        const begin = row * gridCols + col0;
+        if (begin >= numSystems) break;
+        drawBalls(begin, Math.min(numSystems, row * gridCols + col1), systemScale, detail, points);
+    }
+    ctx.restore();
+    tilePassMs[2] += performance.now() - passStart;
+
+    const drawn = tileDrawn;
+    for (let row = row0; row < row1; row++) {
+        const end = Math.min(numSystems, row * gridCols + col1);
+        for (let i = row * gridCols + col0; i < end; i++) {
+            const base = i * STATE_STRIDE;
+            const d = i * TILE_DRAWN_STRIDE;
+            drawn[d] = stateView[base];
+            drawn[d + 1] = stateView[base + 1];
+            drawn[d + 2] = stateView[base + 2];
+            drawn[d + 3] = stateView[base + 3];
+            drawn[d + 4] = trailSize > 0 ? trailX[i * TRAIL_LENGTH + tail] : 0;
+            drawn[d + 5] = trailSize > 0 ? trailY[i * TRAIL_LENGTH + tail] : 0;
+        }
+    }
+    tileStale[k] = 0;
+    tileAge[k] = 0;
+    return systems;
+}
+
+// Strokes system i's whole trail polyline into `target`.
+function strokeTrail(target, i, systemScale) {
+    const size = trailSize;
+    if (size < 2) return;
+    const row = i * TRAIL_LENGTH;
+
+    target.setTransform(systemScale, 0, 0, systemScale, drawCx[i], drawCy[i]);
+
+    target.beginPath();
+    target.strokeStyle = trailColors[i];
+    target.lineWidth = 3;
+
+    let idx = trailHead - size;
+    if (idx < 0) idx += TRAIL_LENGTH;
+    target.moveTo(trailX[row + idx], trailY[row + idx]);
+
+    for (let k = 1; k < size; k++) {
+        idx++;
+        if (idx === TRAIL_LENGTH) idx = 0;
+        target.lineTo(trailX[row + idx], trailY[row + idx]);
+    }
+
+    target.stroke();
+}
+
+// Appends each system's newest trail segment to the head trail layer, retiring the
+// oldest layer whenever the head fills, then composites the layers oldest first.
+// Stale layers (resize, reset, transition) are rebuilt from the point rings.
+function drawTrailsIncremental(t, systemScale) {
+    const framesPerLayer = Math.ceil(TRAIL_LENGTH / TRAIL_LAYERS);
+    let seed = false;
+    if (trailLayersT !== t) {
+        for (const layer of trailLayers) layer.ctx.clearRect(0, 0, layer.canvas.width, layer.canvas.height);
+        trailLayerHead = 0;
+        trailLayerFrames = 0;
+        trailLayersT = t;
+        seed = true;
+    } else if (trailLayerFrames === framesPerLayer) {
+        trailLayerHead = (trailLayerHead + 1) % TRAIL_LAYERS;
+        const layer = trailLayers[trailLayerHead];
+        layer.ctx.setTransform(1, 0, 0, 1, 0, 0);
+        layer.ctx.clearRect(0, 0, layer.canvas.width, layer.canvas.height);
+        trailLayerFrames = 0;
+    }
+
+    const target = trailLayers[trailLayerHead].ctx;
+    target.globalAlpha = lerp(1.0, overlayAlpha, t);
+    target.lineCap = seed ? 'butt' : 'round';
+    const head = trailHead === 0 ? TRAIL_LENGTH - 1 : trailHead - 1;
+    const prev = head === 0 ? TRAIL_LENGTH - 1 : head - 1;
+    for (let i = 0; i < numSystems; i++) {
+        if (seed) {
+            strokeTrail(target, i, systemScale);
+            continue;
+        }
+        if (trailSize < 2) break;
+
+        target.setTransform(systemScale, 0, 0, systemScale, drawCx[i], drawCy[i]);
+        target.beginPath();
+        target.strokeStyle = trailColors[i];
+        target.lineWidth = 3;
+        const row = i * TRAIL_LENGTH;
+        target.moveTo(trailX[row + prev], trailY[row + prev]);
+        target.lineTo(trailX[row + head], trailY[row + head]);
+        target.stroke();
+    }
+    target.setTransform(1, 0, 0, 1, 0, 0);
+    trailLayerFrames++;
+
+    ctx.setTransform(1, 0, 0, 1, 0, 0);
+    const alpha = ctx.globalAlpha;
+    ctx.globalAlpha = 1.0;
+    for (let k = 1; k <= TRAIL_LAYERS; k++) {
+        ctx.drawImage(trailLayers[(trailLayerHead + k) % TRAIL_LAYERS].canvas, 0, 0);
+    }
+    ctx.globalAlpha = alpha;
+}
+
+// Overlay density map: every ball position is binned each frame into a decaying
+// DENSITY_BINS^2 histogram over the container, drawn as one scaled image in place of
+// thousands of overlapping trails.
+function drawDensity(systemScale) {
+    const bins = DENSITY_BINS;
+    const counts = densityCounts;
+    if (!densityActive) counts.fill(0);
+
+    let peak = 0;
+    for (let k = 0; k < counts.length; k++) {
+        const c = counts[k] * DENSITY_DECAY;
+        counts[k] = c;
+        if (c > peak) peak = c;
+    }
+    const toBin = bins / (CONTAINER_RADIUS * 2);
+    for (let i = 0; i < numSystems; i++) {
+        const base = i * STATE_STRIDE;
+        const bx = ((stateView[base] + CONTAINER_RADIUS) * toBin) | 0;
+        const by = ((stateView[base + 1] + CONTAINER_RADIUS) * toBin) | 0;
+        if (bx < 0 || bx >= bins || by < 0 || by >= bins) continue;
+        const k = by * bins + bx;
+        const c = counts[k] + 1;
+        counts[k] = c;
+        if (c > peak) peak = c;
+    }
+
+    // Square-root scaling keeps sparse regions visible next to the dense core.
+    const pixels = densityImage.data;
+    const invPeak = peak > 0 ? 1 / peak : 0;
+    for (let k = 0; k < counts.length; k++) {
+        const p = k * 4;
+        pixels[p] = 77;
+        pixels[p + 1] = 184;
+        pixels[p + 2] = 255;
+        pixels[p + 3] = Math.sqrt(counts[k] * invPeak) * 255;
+    }
+    densityCtx.putImageData(densityImage, 0, 0);
+
+    const alpha = ctx.globalAlpha;
+    ctx.globalAlpha = 1.0;
+    ctx.setTransform(systemScale, 0, 0, systemScale, overlayCenterX, overlayCenterY);
+    ctx.drawImage(densityCanvas, -CONTAINER_RADIUS, -CONTAINER_RADIUS, CONTAINER_RADIUS * 2, CONTAINER_RADIUS * 2);
+    ctx.globalAlpha = alpha;
+}
+
+// Redraws the background and every container ring into the ring layer.
+function drawRingLayer(t, systemScale) {
+    const layer = ringLayerCtx;
+    layer.setTransform(1, 0, 0, 1, 0, 0);
+    layer.globalAlpha = 1.0;
+    layer.fillStyle = '#222';
+    layer.fillRect(0, 0, ringLayer.width, ringLayer.height);
+
+    layer.globalAlpha = lerp(1.0, overlayAlpha, t);
+    layer.lineWidth = 4;
+    layer.strokeStyle = '#555';
+    for (let i = 0; i < numSystems; i++) {
+        if (drawVisible[i] === 0) continue;
+        layer.setTransform(systemScale, 0, 0, systemScale, drawCx[i], drawCy[i]);
+        layer.beginPath();
+        layer.arc(0, 0, CONTAINER_RADIUS, 0, TWO_PI);
+        layer.stroke();
+    }
+    layer.setTransform(1, 0, 0, 1, 0, 0);
+    ringLayerT = t;
+}
+
+// WebGL2 renderer: the same three passes as one instanced draw each.
+function drawFrameGl(t) {
+    if (showTrails) glRenderer.pushTrail(stateView);
+    glRenderer.beginFrame(stateView, {
+        width: canvas.width,
+        height: canvas.height,
+        t,
+        layoutScale,
+        overlayScale,
+        overlayCenterX,
+        overlayCenterY,
+        cellW,
+        cellH,
+        gridCols,
+        alpha: lerp(1.0, overlayAlpha, t)
+    });
+
+    let passStart = performance.now();
+    glRenderer.drawContainers();
+    let passEnd = performance.now();
+    pushSample(renderPassTimes[0], passEnd - passStart);
+    passStart = passEnd;
+
+    if (showTrails) glRenderer.drawTrails();
+    passEnd = performance.now();
+    pushSample(renderPassTimes[1], passEnd - passStart);
+    passStart = passEnd;
+
+    glRenderer.drawBalls();
+    glRenderer.endFrame();
+    pushSample(renderPassTimes[2], performance.now() - passStart);
+}
+
+function updatePerfStats(currentTime) {
+    const elapsed = (currentTime - lastPerfUpdate) / 1000;
+    const stepsPerSec = lastPerfUpdate > 0 ? (completedSteps - lastPerfSteps) / elapsed : 0;
+    lastPerfUpdate = currentTime;
+    lastPerfSteps = completedSteps;
+
+    host.ui.text('perf-frame', ringMean(frameTimes).toFixed(1) + ' / ' + ringPercentile(frameTimes, 0.99).toFixed(1) + ' ms');
+    host.ui.text('perf-steps', stepsPerSec.toFixed(0) + ' / ' + (1 / FIXED_DT).toFixed(0));
+    host.ui.text('perf-dropped', String(Math.floor(droppedSteps)));
+    host.ui.text('perf-render', renderPassTimes.map((ring) => ringMean(ring).toFixed(2)).join(' / ') + ' ms');
+    host.ui.text('perf-tiles', tilesT === 0
+        ? tilesDrawn + ' drawn, ' + tilesPending + ' waiting / ' + tileChange.length + ' (' + tileBudgetMs + ' ms budget)'
+        : 'off');
+    if (recorder) {
+        host.ui.text('perf-record', recorder.records + ' rec, ' + (recorder.length / 1024).toFixed(0) + ' KiB' +
+            (recorder.dropped > 0 ? ', ' + recorder.dropped + ' dropped' : ''));
+    }
+
+    host.ui.text('perf-scheduler', (pageHidden ? 'hidden' : 'visible') + ', ' + backgroundPolicy +
+        (catchUpSteps > 0 ? ' (' + catchUpSteps + ' behind)' : '') + ', ' + activeWorkers + ' / ' + numWorkers + ' workers' +
+        (calibration ? ' (msg ' + calibration.messageMs.toFixed(2) + ' ms, ' + (calibration.systemStepMs * 1000).toFixed(2) + ' us/system-step)' : ''));
+    host.ui.text('perf-output', useSharedState ? 'shared ring'
+        : batchOutput.names.length + ' x ' + batchOutput.encoding + ', ' + (ringMean(batchOutputBytes) / 1024).toFixed(1) + ' KiB/reply');
+
+    const fmt = (ring) => ringPercentile(ring, 0.5).toFixed(2) + ' / ' + ringPercentile(ring, 0.99).toFixed(2) + ' ms';
+    host.ui.text('perf-workers', useWorkStealing
+        ? 'pool  ' + fmt(poolLatency)
+        : workers.slice(0, activeWorkers).map((worker) => 'w' + worker.index + '  ' + fmt(worker.latency)).join('\n'));
+}
+
+// Neighbour pairs across worker slices (or stealing chunks) are not compared, so the
+// pair count can fall a little short of numSystems - 1.
+function updateDivergenceStats() {
+    const pairs = divergence[R_PAIRS];
+    if (pairs === 0 || divergenceStep === 0) {
+        host.ui.text('div-log', '-');
+        host.ui.text('div-ftle', '-');
+        host.ui.text('div-max', '-');
+        host.ui.text('div-frac', '-');
+        return;
+    }
+    const meanLog = divergence[R_LOG_SEPARATION] / pairs;
+    host.ui.text('div-log', meanLog.toFixed(2));
+    host.ui.text('div-ftle', (meanLog / (divergenceStep * FIXED_DT)).toFixed(3));
+    host.ui.text('div-max', divergence[R_MAX_SEPARATION].toFixed(1) + ' px');
+    host.ui.text('div-frac', (divergence[R_DIVERGED] / pairs * 100).toFixed(1) + '%');
+}
+
+function toggleTrails() {
+    showTrails = !showTrails;
+    if (!showTrails) clearTrails();
+}
+
+function toggleOverlay() {
+    showOverlay = !showOverlay;
+    host.ui.visible('overlay-stats', showOverlay);
+    lastUiUpdate = 0;
+}
+
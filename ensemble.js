@@ -0,0 +1,92 @@
+// Parameter-Sweep Ensembles
+// Shared by the page (per-system ball radii for drawing) and the physics workers (per-system
+// physics constants): both expand the same spec into the same table, so only the spec
+// travels in init/resize messages.
+//
+//   ?sweep=gravity:490:1470,restitutionNormal:0.8:1&design=lhs&seed=7
+//
+// design=grid (default) spreads the systems over an even grid of the swept ranges; when the
+// count is not a perfect power the grid repeats, and repeats differ only by their initial
+// offset. design=lhs draws a centred Latin hypercube: every range is cut into one stratum
+// per system and each dimension visits its strata in a seeded random order.
+
+// Sweepable parameters and the range each is clamped to.
+const ENSEMBLE_PARAMETERS = {
+    gravity: [-1e5, 1e5],
+    ballRadius: [1, 299], // inside CONTAINER_RADIUS
+    ballMass: [1e-3, 1e6],
+    containerMass: [1e-3, 1e6],
+    restitutionNormal: [0, 1],
+    restitutionTangent: [0, 1]
+};
+
+// Reads ?sweep= / ?design= / ?seed= into a spec, or null when nothing is swept.
+function parseEnsembleSpec(params) {
+    const ranges = [];
+    for (const part of (params.get('sweep') ?? '').split(',')) {
+        const [name, min, max] = part.split(':');
+        const limits = ENSEMBLE_PARAMETERS[name];
+        const lo = parseFloat(min);
+        const hi = parseFloat(max ?? min);
+        if (!limits || !Number.isFinite(lo) || !Number.isFinite(hi)) continue;
+        const clamp = (v) => Math.max(limits[0], Math.min(limits[1], v));
+        ranges.push({ name, min: clamp(Math.min(lo, hi)), max: clamp(Math.max(lo, hi)) });
+    }
+    if (ranges.length === 0) return null;
+    return {
+        design: params.get('design') === 'lhs' ? 'lhs' : 'grid',
+        seed: parseInt(params.get('seed'), 10) || 1,
+        ranges
+    };
+}
+
+// Expands a spec over `count` systems. Returns { names, columns }, with the value of
+// names[d] for global system ID i at columns[d * count + i].
+function buildEnsemble(spec, count) {
+    const dims = spec.ranges.length;
+    const columns = new Float64Array(dims * count);
+
+    if (spec.design === 'lhs') {
+        // mulberry32, one stream per dimension
+        let state = spec.seed >>> 0;
+        const random = () => {
+            state = (state + 0x6d2b79f5) >>> 0;
+            let t = state;
+            t = Math.imul(t ^ (t >>> 15), t | 1);
+            t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+            return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+        };
+        const strata = new Int32Array(count);
+        for (let d = 0; d < dims; d++) {
+            const { min, max } = spec.ranges[d];
+            for (let i = 0; i < count; i++) strata[i] = i;
+            for (let i = count - 1; i > 0; i--) {
+                const j = Math.floor(random() * (i + 1));
+                const swap = strata[i];
+                strata[i] = strata[j];
+                strata[j] = swap;
+            }
+            for (let i = 0; i < count; i++) {
+                columns[d * count + i] = min + (max - min) * (strata[i] + 0.5) / count;
+            }
+        }
+    } else {
+        const side = Math.max(1, Math.floor(Math.pow(count, 1 / dims) + 1e-9));
+        const points = Math.pow(side, dims);
+        for (let i = 0; i < count; i++) {
+            let index = i % points;
+            for (let d = 0; d < dims; d++) {
+                const { min, max } = spec.ranges[d];
+                const k = index % side;
+                index = Math.floor(index / side);
+                columns[d * count + i] = side > 1 ? min + (max - min) * k / (side - 1) : (min + max) / 2;
+            }
+        }
+    }
+
+    return { names: spec.ranges.map((r) => r.name), columns };
+}
+
+if (typeof module !== 'undefined' && module.exports) {
+    module.exports = { ENSEMBLE_PARAMETERS, parseEnsembleSpec, buildEnsemble };
+}
@@ -0,0 +1,231 @@
+// Page-Side Microbenchmarks (bench.js --suite=micro)
+// Each case times one of engine.js's per-frame hot paths on synthetic state, with no
+// physics workers:
+//   page.unpack        readBatchOutput, the copy/decode loop behind handleWorkerMessage, for
+//                      one batch covering every system in the page's ?output=/?encoding=
+//   page.trail.push    pushTrailPoints
+//   page.trail.stroke  strokeTrail over every system with full trails (the polyline pass)
+//   page.pass.rings / .trails / .balls
+//                      the three drawFrame2d passes (renderPassTimes) with every ball
+//                      moving, in the grid layout and in the settled overlay
+//   page.frame         a whole grid-layout drawFrame2d with every ball moving, tiled
+//                      (engine.js TILE_PX) when the page would tile that many systems
+//
+// The page scripts and the physics kernel share constant names, so this runs in a global
+// scope of its own after the page scripts: a dedicated worker in a browser (drawing into
+// OffscreenCanvas) or a worker thread from bench.js in Node. Node has no canvas, so there
+// the passes draw into a no-op 2D context and time the JavaScript side only.
+
+const MICRO_VIEWPORT = { width: 1280, height: 720, graphWidth: 300, graphHeight: 100 };
+const MICRO_UNPACK_ROUNDS = 200;
+const MICRO_TURN = 0.1; // rad per frame about each container centre: up to 27 px, a fast ball
+
+if (typeof importScripts === 'function') {
+    importScripts('ensemble.js', 'output-format.js', 'recorder.js', 'engine.js');
+    // bench.js sends { systems, frames } and gets { type: 'done', results } back.
+    self.onmessage = (e) => {
+        self.postMessage({ type: 'done', results: runPageMicrobench(e.data.systems, e.data.frames) });
+    };
+}
+
+// A canvas whose 2D context accepts every call the Canvas2D renderer makes and draws nothing.
+function nullCanvas() {
+    const noop = () => {};
+    const context = {
+        canvas: null,
+        fillStyle: '',
+        strokeStyle: '',
+        lineWidth: 1,
+        lineCap: 'butt',
+        globalAlpha: 1,
+        globalCompositeOperation: 'source-over',
+        save: noop,
+        restore: noop,
+        setTransform: noop,
+        translate: noop,
+        rotate: noop,
+        beginPath: noop,
+        moveTo: noop,
+        lineTo: noop,
+        arc: noop,
+        rect: noop,
+        clip: noop,
+        stroke: noop,
+        fill: noop,
+        fillRect: noop,
+        clearRect: noop,
+        drawImage: noop,
+        putImageData: noop,
+        setLineDash: noop,
+        createImageData: (width, height) => ({ width, height, data: new Uint8ClampedArray(width * height * 4) })
+    };
+    const target = { width: 1, height: 1, getContext: () => context };
+    context.canvas = target;
+    return target;
+}
+
+// Stands the Canvas2D renderer up for `count` systems: balls spread over each container
+// and full trails on circular paths, so every pass and polyline has its steady-state work.
+function setUpPage(count) {
+    host = {
+        viewport: () => MICRO_VIEWPORT,
+        ui: { text() {}, visible() {}, title() {}, commit() {} },
+        saveFile() {}
+    };
+    const makeCanvas = typeof OffscreenCanvas === 'function' ? () => new OffscreenCanvas(1, 1) : nullCanvas;
+    canvas = makeCanvas();
+    graphCanvas = makeCanvas();
+    trailLayers = [];
+    initCanvas2d();
+    allocateSystems(count);
+    resize();
+
+    const state = slotViews[0];
+    for (let i = 0; i < count; i++) {
+        const base = i * STATE_STRIDE;
+        const r = (CONTAINER_RADIUS - BALL_RADIUS) * Math.sqrt((i % 97 + 0.5) / 97);
+        const a = i * 2.399963; // golden angle
+        state[base] = r * Math.cos(a);
+        state[base + 1] = r * Math.sin(a);
+        state[base + 2] = a;
+        state[base + 3] = 0.1 * i;
+        const row = i * TRAIL_LENGTH;
+        for (let k = 0; k < TRAIL_LENGTH; k++) {
+            const p = a + k * 0.05;
+            trailX[row + k] = 0.5 * r * Math.cos(p);
+            trailY[row + k] = 0.5 * r * Math.sin(p);
+        }
+    }
+    stateView = state;
+    trailHead = 0;
+    trailSize = TRAIL_LENGTH;
+    showTrails = true;
+}
+
+// One message-mode batch for every system in the negotiated format, with a plausible mix
+// of payload values (delta: mostly one- and two-byte varints).
+function syntheticBatch(worker) {
+    const buffer = new ArrayBuffer(expectedWorkerBufferBytes(worker));
+    const header = new Float64Array(buffer, 0, BATCH_HEADER_DOUBLES);
+    const values = numSystems * batchOutput.names.length;
+    let bytes = values * batchOutput.valueBytes;
+    if (batchOutput.encoding === 'float32') {
+        const out = new Float32Array(buffer, BATCH_HEADER_BYTES, values);
+        for (let k = 0; k < values; k++) out[k] = ((k * 7919) % 541) - 270;
+    } else if (batchOutput.encoding === 'int16') {
+        const out = new Int16Array(buffer, BATCH_HEADER_BYTES, values);
+        for (let k = 0; k < values; k++) out[k] = ((k * 7919) % 60001) - 30000;
+    } else {
+        const out = new Uint8Array(buffer, BATCH_HEADER_BYTES);
+        let p = 0;
+        for (let k = 0; k < values; k++) {
+            const d = ((k * 7919) % 301) - 150;
+            let z = d >= 0 ? d * 2 : -d * 2 - 1;
+            while (z >= 128) {
+                out[p++] = (z & 127) | 128;
+                z >>>= 7;
+            }
+            out[p++] = z;
+        }
+        bytes = p;
+    }
+    header[BATCH_PAYLOAD_BYTES] = bytes;
+    header[BATCH_KEYFRAME] = 0;
+    return { buffer, header };
+}
+
+function microResult(bench, systems, samples) {
+    samples.sort();
+    const n = samples.length;
+    const meanMs = samples.reduce((a, b) => a + b, 0) / Math.max(1, n);
+    return {
+        bench,
+        systems,
+        samples: n,
+        meanMs,
+        p50Ms: n > 0 ? samples[Math.floor(0.5 * n)] : 0,
+        p99Ms: n > 0 ? samples[Math.min(n - 1, Math.floor(0.99 * n))] : 0,
+        nsPerSystem: meanMs * 1e6 / systems
+    };
+}
+
+function timeRounds(rounds, body) {
+    const samples = new Float64Array(rounds);
+    for (let r = 0; r < rounds; r++) {
+        const start = performance.now();
+        body();
+        samples[r] = performance.now() - start;
+    }
+    return samples;
+}
+
+// Runs every case at each system count; `frames` drawFrame2d calls per layout.
+function runPageMicrobench(systemCounts, frames) {
+    const results = [];
+    for (const count of systemCounts) {
+        setUpPage(count);
+
+        const worker = { systemIds: Array.from({ length: count }, (_, i) => i) };
+        const { buffer, header } = syntheticBatch(worker);
+        timeRounds(10, () => readBatchOutput(worker, buffer, header, 1));
+        const unpack = microResult('page.unpack', count, timeRounds(MICRO_UNPACK_ROUNDS, () => readBatchOutput(worker, buffer, header, 1)));
+        unpack.output = batchOutput.names.length + 'x' + batchOutput.encoding;
+        results.push(unpack);
+
+        results.push(microResult('page.trail.push', count, timeRounds(frames, pushTrailPoints)));
+        trailSize = TRAIL_LENGTH;
+        const systemScale = layoutScale;
+        results.push(microResult('page.trail.stroke', count, timeRounds(frames, () => {
+            for (let i = 0; i < numSystems; i++) strokeTrail(ctx, i, systemScale);
+        })));
+
+        for (const [layout, t] of [['grid', 0], ['overlay', 1]]) {
+            drawFrame2d(t); // builds the cached layers outside the samples
+            for (const ring of renderPassTimes) {
+                ring.head = 0;
+                ring.size = 0;
+            }
+            for (let f = 0; f < frames; f++) {
+                moveBalls();
+                drawFrame2d(t);
+            }
+            ['rings', 'trails', 'balls'].forEach((pass, k) => {
+                const ring = renderPassTimes[k];
+                const entry = microResult(`page.pass.${pass}`, count, Float64Array.from(ring.values.subarray(0, ring.size)));
+                entry.layout = layout;
+                entry.tiled = t === 0 && tilesT === 0;
+                results.push(entry);
+            });
+        }
+
+        // Every ball moves each frame, so every tile competes for the budget.
+        drawFrame2d(0);
+        let tiles = 0;
+        const frame = microResult('page.frame', count, timeRounds(frames, () => {
+            moveBalls();
+            drawFrame2d(0);
+            tiles += tilesDrawn;
+        }));
+        frame.layout = 'grid';
+        frame.tiled = tilesT === 0;
+        if (frame.tiled) {
+            frame.tilesPerFrame = tiles / frames;
+            frame.tileCount = tileChange.length;
+        }
+        results.push(frame);
+    }
+    return results;
+}
+
+// Turns every ball a little further around its container.
+function moveBalls() {
+    const c = Math.cos(MICRO_TURN);
+    const s = Math.sin(MICRO_TURN);
+    for (let base = 0; base < stateView.length; base += STATE_STRIDE) {
+        const x = stateView[base];
+        const y = stateView[base + 1];
+        stateView[base] = c * x - s * y;
+        stateView[base + 1] = s * x + c * y;
+        stateView[base + 2] += MICRO_TURN;
+    }
+}
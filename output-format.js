@@ -0,0 +1,63 @@
+// State Output Formats
+// Shared by the page and the physics workers: which per-system values a message-mode batch
+// carries back, and how they are encoded. The page picks a format in init/resize and sizes
+// the batch buffers for it; the worker encodes to match.
+//
+//   ?output=position,angles,velocity&encoding=float32|int16|delta
+//
+// Value groups: position (ballX, ballY), angles (ballAngle, containerAngle) and velocity
+// (ballVx, ballVy). Position is always sent, since nothing can be drawn without it. The
+// default, position,angles as float32, is the renderer's full state.
+// Encodings:
+//   float32 - one Float32 per value.
+//   int16   - one Int16 per value in fixed point: positions relative to the container
+//             radius, velocities relative to OUTPUT_VELOCITY_RANGE (both saturating) and
+//             angles modulo 2 pi.
+//   delta   - the int16 values as zigzag varints (1-3 bytes) of the wrapped difference
+//             from the previous batch. A batch flagged as a keyframe is relative to 0.
+// Shared-memory modes write the full float32 state into the ring in place, so there is no
+// transfer to shrink and they ignore the format.
+
+const OUTPUT_GROUPS = {
+    position: ['x', 'y'],
+    angles: ['angle', 'containerAngle'],
+    velocity: ['vx', 'vy']
+};
+const OUTPUT_ENCODINGS = ['float32', 'int16', 'delta'];
+const OUTPUT_DEFAULT_GROUPS = ['position', 'angles'];
+const OUTPUT_POSITION_RANGE = 300; // CONTAINER_RADIUS
+const OUTPUT_VELOCITY_RANGE = 4800; // px/s
+const OUTPUT_INT16_MAX = 32767;
+
+// Reads ?output= / ?encoding= into { groups, encoding }.
+function parseOutputFormat(params) {
+    const requested = params.get('output')?.split(',');
+    const groups = requested
+        ? Object.keys(OUTPUT_GROUPS).filter((g) => g === 'position' || requested.includes(g))
+        : OUTPUT_DEFAULT_GROUPS;
+    const encoding = params.get('encoding');
+    return { groups, encoding: OUTPUT_ENCODINGS.includes(encoding) ? encoding : 'float32' };
+}
+
+// Expands a format into its per-system value list: names, fixed-point quanta, which values
+// wrap (angles) and the most bytes one value can take.
+function outputLayout(format) {
+    const names = [];
+    for (const group of Object.keys(OUTPUT_GROUPS)) {
+        if (format.groups.includes(group)) names.push(...OUTPUT_GROUPS[group]);
+    }
+    const quanta = new Float64Array(names.length);
+    const wraps = new Uint8Array(names.length);
+    for (let v = 0; v < names.length; v++) {
+        const name = names[v];
+        wraps[v] = name === 'angle' || name === 'containerAngle' ? 1 : 0;
+        quanta[v] = wraps[v] ? 2 * Math.PI / 65536
+            : (name === 'vx' || name === 'vy' ? OUTPUT_VELOCITY_RANGE : OUTPUT_POSITION_RANGE) / OUTPUT_INT16_MAX;
+    }
+    const valueBytes = format.encoding === 'float32' ? 4 : format.encoding === 'int16' ? 2 : 3;
+    return { encoding: format.encoding, names, quanta, wraps, valueBytes };
+}
+
+if (typeof module !== 'undefined' && module.exports) {
+    module.exports = { OUTPUT_GROUPS, OUTPUT_ENCODINGS, OUTPUT_DEFAULT_GROUPS, OUTPUT_INT16_MAX, parseOutputFormat, outputLayout };
+}
@@ -1,7 +1,24 @@
 // Physics Worker for Parallel Simulation
 // This worker handles physics updates for a subset of simulation systems
 
+// Node (bench.js): worker_threads get a `self` bridged to parentPort, while require()
+// on the main thread just exposes the kernel through module.exports.
+if (typeof self === 'undefined' && typeof require === 'function') {
+    const { parentPort } = require('worker_threads');
+    globalThis.self = globalThis;
+    if (parentPort) {
+        self.postMessage = (msg, transfer) => parentPort.postMessage(msg, transfer);
+        parentPort.on('message', (data) => self.onmessage({ data }));
+    }
+}
+
+// Sweep specs (ensemble.js) expand into the same table here as on the page, and batch
+// output formats (output-format.js) lay out the same values.
+if (typeof importScripts === 'function') importScripts('ensemble.js', 'output-format.js');
+else Object.assign(globalThis, require('./ensemble.js'), require('./output-format.js'));
+
 // --- Physics Constants ---
+// Defaults for every system; an ensemble (see ENSEMBLE_FIELDS) overrides them per system.
 const SUB_STEPS = 16; 
 const GRAVITY = 9.81 * 100;
 const CONTAINER_RADIUS = 300;
@@ -10,144 +27,707 @@ const BALL_MASS = 10;
 const CONTAINER_MASS = 200;
 const RESTITUTION_NORMAL = 1.0; 
 const RESTITUTION_TANGENT = 1.0; 
-const NUM_SYSTEMS = 64;
 const STATE_STRIDE = 4; // ballX, ballY, ballAngle, containerAngle
+const INITIAL_SPREAD = 0.02; // px of initial ball x offset across the whole multiverse
+const FIXED_DT = 1/180; // step the coefficient cache starts out for (must match page)
+
+// Worker command ops (must match page)
+const OP_UPDATE = 1;
+const OP_RESET = 2;
+
+// Work-stealing claim words (must match page): batch ID low bits above the chunk count.
+const CLAIM_CHUNK_BITS = 16;
+const CLAIM_CHUNK_MASK = (1 << CLAIM_CHUNK_BITS) - 1;
+const CLAIM_TAG_MASK = 0x7fff;
+
+// Message-mode batches (must match page): the page transfers a bare ArrayBuffer holding
+// a Float64 header and room for the negotiated output (output-format.js); the worker runs
+// the command, writes the energy and output into the same buffer and transfers it back.
+const BATCH_OP = 0;
+const BATCH_ID = 1;
+const BATCH_DT = 2;
+const BATCH_STEPS = 3;
+const BATCH_FIRST_STEP = 4;
+const BATCH_REDUCTION = 5; // REDUCTION_DOUBLES
+const BATCH_PAYLOAD_BYTES = 13; // output bytes written after the header
+const BATCH_KEYFRAME = 14; // 1 when delta output is relative to 0
+const BATCH_HEADER_DOUBLES = 15;
+const BATCH_HEADER_BYTES = BATCH_HEADER_DOUBLES * 8;
+
+// Per-batch reduction over this worker's systems, returned with every batch (must match
+// page): the page's statistics then cost O(workers) instead of O(systems).
+const R_ENERGY = 0;
+const R_SUM_X = 1; // ball position sums
+const R_SUM_Y = 2;
+const R_SUM_DIST = 3; // sum of ball distances from the container centre
+// Divergence analytics, on sampled batches only (R_PAIRS is 0 otherwise): over each pair of
+// neighbouring systems (consecutive IDs, so neighbouring initial offsets) in one slice,
+const R_PAIRS = 4; // number of pairs
+const R_LOG_SEPARATION = 5; // sum of ln(ball separation / initial separation)
+const R_MAX_SEPARATION = 6; // largest ball separation (page takes the max, not the sum)
+const R_DIVERGED = 7; // pairs separated by more than DIVERGED_SEPARATION
+const REDUCTION_DOUBLES = 8;
+const DIVERGED_SEPARATION = BALL_RADIUS;
+
+// --- State Store ---
+// Per-system state lives in field-major columns of one Float64Array so the
+// stepping kernel walks contiguous memory instead of per-system objects.
+// The work-stealing scheduler backs it with a SharedArrayBuffer (page must match NUM_FIELDS).
+const F_X = 0;
+const F_Y = 1;
+const F_VX = 2;
+const F_VY = 3;
+const F_ANGLE = 4;
+const F_ANGULAR_VELOCITY = 5;
+const F_CONTAINER_ANGLE = 6;
+const F_CONTAINER_ANGULAR_VELOCITY = 7;
+const F_INITIAL_ENERGY = 8;
+const F_SUB_STEPS = 9;
+// Per-system physics constants, set by reset() from the defaults or the ensemble...
+const F_GRAVITY = 10;
+const F_BALL_RADIUS = 11;
+const F_BALL_MASS = 12;
+const F_CONTAINER_MASS = 13;
+const F_RESTITUTION_NORMAL = 14;
+const F_RESTITUTION_TANGENT = 15;
+// ...and the terms derived from them (deriveParameters), cached for the kernel.
+const F_MAX_DIST = 16;
+const F_INV_MASS = 17;
+const F_INV_INERTIA_B = 18;
+const F_INV_INERTIA_C = 19;
+const F_EFF_MASS = 20;
+const F_HALF_MASS = 21; // energy = F_HALF_MASS v^2 + F_HALF_INERTIA_B w^2 + F_HALF_INERTIA_C wc^2
+const F_HALF_INERTIA_B = 22; //          + F_POTENTIAL_SLOPE y
+const F_HALF_INERTIA_C = 23;
+const F_POTENTIAL_SLOPE = 24;
+const F_ELASTIC = 25; // 1 when both restitutions are 1 (energy is corrected), else 0
+const F_MAX_DIST_SQ = 26;
+// Sub-step coefficients for the store's stepDt and the system's F_SUB_STEPS
+// (deriveStepCoefficients), so the kernel's setup pass only loads them.
+const F_SUB_DT = 27;
+const F_GRAVITY_SUB_DT = 28;
+const F_HALF_GRAVITY_SUB_DT_SQ = 29;
+// Event-driven integration: time from the current state to the system's next event (see
+// integrateEvents), NaN when it has to be predicted afresh and EVENT_RESTING in contact.
+const F_NEXT_EVENT = 30;
+const NUM_FIELDS = 31;
+
+// Store field for each ensemble.js parameter name.
+const ENSEMBLE_FIELDS = {
+    gravity: F_GRAVITY,
+    ballRadius: F_BALL_RADIUS,
+    ballMass: F_BALL_MASS,
+    containerMass: F_CONTAINER_MASS,
+    restitutionNormal: F_RESTITUTION_NORMAL,
+    restitutionTangent: F_RESTITUTION_TANGENT
+};
+
+// Systems per kernel block: all sub-steps run over one block before moving on,
+// keeping the inner loop tight while the block's columns stay in cache.
+const KERNEL_BLOCK = 256;
+
+// Relative slack on the free-flight bound so rounding in the closed form can never
+// carry a ball onto the wall inside a skipped sub-step.
+const FREE_FLIGHT_MARGIN = 1e-9;
+
+// Adaptive sub-stepping: per-system counts stay within [MIN_SUB_STEPS, MAX_SUB_STEPS].
+// A count doubles when the step's energy error (relative, before correction) exceeds
+// the accuracy bound, and halves once it is below ADAPT_RELAX of it. Independently, no
+// sub-step may carry the ball more than CONTACT_SLOP past its gap to the wall.
+const MIN_SUB_STEPS = 2;
+const MAX_SUB_STEPS = 64;
+const DEFAULT_SUB_STEP_ACCURACY = 2e-5; // about the mean error of a fixed SUB_STEPS
+const ADAPT_RELAX = 1 / 8;
+const CONTACT_SLOP = 0.5;
+
+// Event-driven integration (store.events): contacts are found to within EVENT_TOLERANCE px
+// of the wall in at most EVENT_MAX_ITERATIONS bound refinements (otherwise the event is a
+// plain re-prediction). A step's events sit in EVENT_BUCKETS calendar buckets. A system
+// with more than EVENT_MAX_CONTACTS contacts in one step is in resting contact, where
+// bounces would never end: it sub-steps like the kernel until a step ends off the wall.
+const EVENT_TOLERANCE = 1e-6;
+const EVENT_MAX_ITERATIONS = 32;
+const EVENT_BUCKETS = 32;
+const EVENT_MAX_CONTACTS = 8;
+const EVENT_RESTING = -1;
+
+class SystemStore {
+    // With a buffer, the store views existing (possibly shared) state instead of resetting it.
+    constructor(ids, buffer = null) {
+        const count = ids.length;
+        this.ids = Int32Array.from(ids);
+        this.count = count;
+        this.data = buffer ? new Float64Array(buffer, 0, NUM_FIELDS * count) : new Float64Array(NUM_FIELDS * count);
+        this.x = this.field(F_X);
+        this.y = this.field(F_Y);
+        this.vx = this.field(F_VX);
+        this.vy = this.field(F_VY);
+        this.angle = this.field(F_ANGLE);
+        this.angularVelocity = this.field(F_ANGULAR_VELOCITY);
+        this.containerAngle = this.field(F_CONTAINER_ANGLE);
+        this.containerAngularVelocity = this.field(F_CONTAINER_ANGULAR_VELOCITY);
+        this.initialEnergy = this.field(F_INITIAL_ENERGY);
+        this.subSteps = this.field(F_SUB_STEPS);
+        this.gravity = this.field(F_GRAVITY);
+        this.ballRadius = this.field(F_BALL_RADIUS);
+        this.ballMass = this.field(F_BALL_MASS);
+        this.containerMass = this.field(F_CONTAINER_MASS);
+        this.restitutionNormal = this.field(F_RESTITUTION_NORMAL);
+        this.restitutionTangent = this.field(F_RESTITUTION_TANGENT);
+        this.maxDist = this.field(F_MAX_DIST);
+        this.invMass = this.field(F_INV_MASS);
+        this.invInertiaB = this.field(F_INV_INERTIA_B);
+        this.invInertiaC = this.field(F_INV_INERTIA_C);
+        this.effMass = this.field(F_EFF_MASS);
+        this.halfMass = this.field(F_HALF_MASS);
+        this.halfInertiaB = this.field(F_HALF_INERTIA_B);
+        this.halfInertiaC = this.field(F_HALF_INERTIA_C);
+        this.potentialSlope = this.field(F_POTENTIAL_SLOPE);
+        this.elastic = this.field(F_ELASTIC);
+        this.maxDistSq = this.field(F_MAX_DIST_SQ);
+        this.subDt = this.field(F_SUB_DT);
+        this.gravitySubDt = this.field(F_GRAVITY_SUB_DT);
+        this.halfGravitySubDtSq = this.field(F_HALF_GRAVITY_SUB_DT_SQ);
+        this.nextEvent = this.field(F_NEXT_EVENT);
+        this.stepDt = FIXED_DT; // dt the sub-step coefficients were derived for
+
+        // Per-block kernel scratch: the leading sub-steps of the current block that were
+        // advanced in closed form.
+        this.freeSteps = new Int32Array(KERNEL_BLOCK);
+        this.freeFlightSkip = true;
+        this.adaptive = false;
+        this.accuracy = DEFAULT_SUB_STEP_ACCURACY;
+        this.correctEvery = 1;
+        // Event-driven integration: calendar scratch, sized on first use, and a count of
+        // the events processed (bench.js).
+        this.events = false;
+        this.eventTime = null;
+        this.eventNext = null;
+        this.eventContacts = null;
+        this.eventBuckets = new Int32Array(EVENT_BUCKETS);
+        this.eventsProcessed = 0;
+
+        if (buffer) return;
+        for (let i = 0; i < count; i++) {
+            this.reset(i);
+        }
+    }
+
+    field(f) {
+        return this.data.subarray(f * this.count, (f + 1) * this.count);
+    }
+
+    reset(i) {
+        const offset = (this.ids[i] / numSystems * INITIAL_SPREAD) - INITIAL_SPREAD / 2;
+
+        this.x[i] = 1 + offset;
+        this.y[i] = -220;
+        this.vx[i] = 0;
+        this.vy[i] = 0;
+        this.angle[i] = 0;
+        this.angularVelocity[i] = 0;
+        this.containerAngle[i] = 0;
+        this.containerAngularVelocity[i] = 0;
+        this.subSteps[i] = SUB_STEPS;
+        this.nextEvent[i] = NaN;
 
-// --- Simulation Class ---
-class SimSystem {
-    constructor(id) {
-        this.id = id;
-        this.ball = {};
-        this.container = {};
-        this.initialEnergy = 0;
-        this.reset(id);
-    }
-
-    reset(id) {
-        const offset = (id / NUM_SYSTEMS * 0.02) - 0.01;
-        
-        this.ball = {
-            x: 1 + offset, 
-            y: -220,
-            vx: 0, vy: 0,
-            angle: 0, angularVelocity: 0,
-            radius: BALL_RADIUS, mass: BALL_MASS, 
-            inertia: 0.5 * BALL_MASS * (BALL_RADIUS * BALL_RADIUS)
-        };
-
-        this.container = {
-            angle: 0, angularVelocity: 0,
-            radius: CONTAINER_RADIUS, mass: CONTAINER_MASS,
-            inertia: CONTAINER_MASS * (CONTAINER_RADIUS * CONTAINER_RADIUS)
-        };
-
-        this.initialEnergy = this.calculateEnergy().total;
-    }
-
-    calculateEnergy() {
-        const b = this.ball;
-        const c = this.container;
-
-        const v2 = b.vx * b.vx + b.vy * b.vy;
-        const keLin = 0.5 * b.mass * v2;
-        const keRotB = 0.5 * b.inertia * (b.angularVelocity * b.angularVelocity);
-        const keRotC = 0.5 * c.inertia * (c.angularVelocity * c.angularVelocity);
-        const pe = -b.mass * GRAVITY * b.y;
-
-        return {
-            total: keLin + keRotB + keRotC + pe,
-            pe: pe
-        };
-    }
-
-    update(dt) {
-        const subDt = dt / SUB_STEPS;
-        const b = this.ball;
-        const c = this.container;
-        const gravitySubDt = GRAVITY * subDt;
-        const rB = b.radius;
-        const rC = c.radius;
-        const maxDist = rC - rB;
-        const maxDistSq = maxDist * maxDist;
-
-        const invMass = 1 / b.mass;
-        const invInertiaB = 1 / b.inertia;
-        const invInertiaC = 1 / c.inertia;
-
-        // Effective mass for tangential impulse (constant for this system)
-        const invM = invMass;
+        this.gravity[i] = GRAVITY;
+        this.ballRadius[i] = BALL_RADIUS;
+        this.ballMass[i] = BALL_MASS;
+        this.containerMass[i] = CONTAINER_MASS;
+        this.restitutionNormal[i] = RESTITUTION_NORMAL;
+        this.restitutionTangent[i] = RESTITUTION_TANGENT;
+        if (ensemble) {
+            const { names, columns } = ensemble;
+            for (let d = 0; d < names.length; d++) {
+                this.data[ENSEMBLE_FIELDS[names[d]] * this.count + i] = columns[d * numSystems + this.ids[i]];
+            }
+        }
+        this.deriveParameters(i);
+
+        this.initialEnergy[i] = this.calculateEnergy(i);
+    }
+
+    // Caches the kernel's per-system terms from system i's physics constants.
+    deriveParameters(i) {
+        const rB = this.ballRadius[i];
+        const rC = CONTAINER_RADIUS;
+        const ballInertia = 0.5 * this.ballMass[i] * (rB * rB);
+        const containerInertia = this.containerMass[i] * (rC * rC);
+        const invMass = 1 / this.ballMass[i];
+        const invInertiaB = 1 / ballInertia;
+        const invInertiaC = 1 / containerInertia;
+
+        // Effective mass for the tangential impulse
         const invIb = (rB * rB) * invInertiaB;
         const invIw = (rC * rC) * invInertiaC;
-        const effMass = 1 / (invM + invIb + invIw);
-
-        for (let i = 0; i < SUB_STEPS; i++) {
-            // Integration
-            b.vy += gravitySubDt;
-            b.x += b.vx * subDt;
-            b.y += b.vy * subDt;
-            b.angle += b.angularVelocity * subDt;
-            c.angle += c.angularVelocity * subDt;
-
-            // Collision
-            const x = b.x;
-            const y = b.y;
-            const distSq = x * x + y * y;
 
-            // Avoid sqrt unless we might be colliding.
-            if (distSq >= maxDistSq) {
-                const dist = Math.sqrt(distSq);
-                if (dist <= 0) continue;
+        this.maxDist[i] = rC - rB;
+        this.invMass[i] = invMass;
+        this.invInertiaB[i] = invInertiaB;
+        this.invInertiaC[i] = invInertiaC;
+        this.effMass[i] = 1 / (invMass + invIb + invIw);
+        this.halfMass[i] = 0.5 * this.ballMass[i];
+        this.halfInertiaB[i] = 0.5 * ballInertia;
+        this.halfInertiaC[i] = 0.5 * containerInertia;
+        this.potentialSlope[i] = -this.ballMass[i] * this.gravity[i];
+        this.elastic[i] = this.restitutionNormal[i] === 1 && this.restitutionTangent[i] === 1 ? 1 : 0;
+        this.maxDistSq[i] = this.maxDist[i] * this.maxDist[i];
+        this.deriveStepCoefficients(i);
+    }
+
+    // Caches system i's sub-step length and gravity terms for stepDt and its current
+    // sub-step count. Rerun whenever either changes.
+    deriveStepCoefficients(i) {
+        const subDt = this.stepDt / this.subSteps[i];
+        const gravity = this.gravity[i];
+        this.subDt[i] = subDt;
+        this.gravitySubDt[i] = gravity * subDt;
+        this.halfGravitySubDtSq[i] = 0.5 * gravity * subDt * subDt;
+    }
+
+    // Rederives every system's sub-step coefficients for a new dt. The page always steps
+    // FIXED_DT, so this only runs for callers (bench.js) stepping something else.
+    setStepDt(dt) {
+        this.stepDt = dt;
+        for (let i = 0; i < this.count; i++) {
+            this.deriveStepCoefficients(i);
+        }
+    }
+
+    // Total energy of system i.
+    calculateEnergy(i) {
+        const vx = this.vx[i];
+        const vy = this.vy[i];
+        const w = this.angularVelocity[i];
+        const wc = this.containerAngularVelocity[i];
+
+        const v2 = vx * vx + vy * vy;
+        const keLin = this.halfMass[i] * v2;
+        const keRotB = this.halfInertiaB[i] * (w * w);
+        const keRotC = this.halfInertiaC[i] * (wc * wc);
+        const pe = this.potentialSlope[i] * this.y[i];
+
+        return keLin + keRotB + keRotC + pe;
+    }
+
+    // Advances systems [begin, end) by dt and returns their summed energy.
+    update(dt, begin = 0, end = this.count) {
+        this.integrate(dt, begin, end);
+        return this.settleEnergy(begin, end, dt);
+    }
+
+    // Runs the SUB_STEPS integration/collision loop. collide = false integrates free flight
+    // only (bench.js uses it to split kernel time by phase).
+    //
+    // With freeFlightSkip, each system first gets a conservative time-to-impact bound: after
+    // k sub-steps the ball has moved at most |v| k h + g h^2 k(k+1)/2, so while that stays
+    // inside the gap to maxDist no collision test can fire. Those k sub-steps are applied
+    // in closed form (the same semi-implicit Euler sums, exact up to rounding) and the
+    // sub-step loop only runs the remainder.
+    //
+    // Each system runs its own sub-step count (F_SUB_STEPS): SUB_STEPS unless the adaptive
+    // controller in settleEnergy has moved it. Everything that is constant between steps
+    // comes precomputed from the store (deriveParameters, deriveStepCoefficients).
+    integrate(dt, begin = 0, end = this.count, collide = true) {
+        if (collide && this.events) {
+            this.integrateEvents(dt, begin, end);
+            return;
+        }
+        if (dt !== this.stepDt) this.setStepDt(dt);
+        const skip = collide && this.freeFlightSkip;
+        const freeSteps = this.freeSteps;
+        const pn = this.subSteps;
+        const psd = this.subDt;
+        const pgs = this.gravitySubDt;
+        const phg = this.halfGravitySubDtSq;
+        const pmq = this.maxDistSq;
+        const rC = CONTAINER_RADIUS;
+        const prB = this.ballRadius;
+        const pmd = this.maxDist;
+        const prn = this.restitutionNormal;
+        const prt = this.restitutionTangent;
+        const pem = this.effMass;
+        const pim = this.invMass;
+        const pib = this.invInertiaB;
+        const pic = this.invInertiaC;
+
+        const px = this.x;
+        const py = this.y;
+        const pvx = this.vx;
+        const pvy = this.vy;
+        const pa = this.angle;
+        const pw = this.angularVelocity;
+        const pca = this.containerAngle;
+        const pcw = this.containerAngularVelocity;
+
+        for (let blockStart = begin; blockStart < end; blockStart += KERNEL_BLOCK) {
+            const blockEnd = Math.min(blockStart + KERNEL_BLOCK, end);
+
+            // Per-system setup, with the free-flight prefix applied in the same pass.
+            let blockSteps = 0;
+            for (let i = blockStart; i < blockEnd; i++) {
+                const n = pn[i];
+                const j = i - blockStart;
+                freeSteps[j] = 0;
+                if (n > blockSteps) blockSteps = n;
+                if (!skip) continue;
 
-                const invDist = 1 / dist;
-                const nx = x * invDist;
-                const ny = y * invDist;
+                const subDt = psd[i];
+                const maxDist = pmd[i];
+                const halfGravitySubDtSq = phg[i];
+                const reachA = Math.abs(halfGravitySubDtSq);
+                const dist = Math.sqrt(px[i] * px[i] + py[i] * py[i]);
+                const gap = (maxDist - dist) - maxDist * FREE_FLIGHT_MARGIN;
+                if (gap <= 0) continue;
+                // Largest k with reachA k^2 + (|v| h + reachA) k <= gap.
+                const reachB = Math.sqrt(pvx[i] * pvx[i] + pvy[i] * pvy[i]) * subDt + reachA;
+                const root = reachA > 0
+                    ? (Math.sqrt(reachB * reachB + 4 * reachA * gap) - reachB) / (2 * reachA)
+                    : (reachB > 0 ? gap / reachB : n);
+                const k = Math.min(n, Math.floor(root));
+                freeSteps[j] = k;
+                if (k === 0) continue;
 
-                // Fix penetration (only if needed)
-                const pen = dist - maxDist;
-                if (pen > 0) {
-                    b.x -= nx * pen;
-                    b.y -= ny * pen;
+                const span = k * subDt;
+                const vy0 = pvy[i];
+                px[i] += pvx[i] * span;
+                py[i] += vy0 * span + halfGravitySubDtSq * k * (k + 1);
+                pvy[i] = vy0 + pgs[i] * k;
+                pa[i] += pw[i] * span;
+                pca[i] += pcw[i] * span;
+            }
+
+            for (let step = 0; step < blockSteps; step++) {
+                for (let i = blockStart; i < blockEnd; i++) {
+                    const j = i - blockStart;
+                    if (step < freeSteps[j] || step >= pn[i]) continue;
+
+                    // Integration
+                    const subDt = psd[i];
+                    const vy = pvy[i] + pgs[i];
+                    const x = px[i] + pvx[i] * subDt;
+                    const y = py[i] + vy * subDt;
+                    pvy[i] = vy;
+                    px[i] = x;
+                    py[i] = y;
+                    pa[i] += pw[i] * subDt;
+                    pca[i] += pcw[i] * subDt;
+                    if (!collide) continue;
+
+                    // Collision
+                    const distSq = x * x + y * y;
+
+                    // Avoid sqrt unless we might be colliding.
+                    if (distSq < pmq[i]) continue;
+
+                    const dist = Math.sqrt(distSq);
+                    if (dist <= 0) continue;
+
+                    const invDist = 1 / dist;
+                    const nx = x * invDist;
+                    const ny = y * invDist;
+
+                    // Fix penetration (only if needed)
+                    const pen = dist - pmd[i];
+                    if (pen > 0) {
+                        px[i] = x - nx * pen;
+                        py[i] = y - ny * pen;
+                    }
+
+                    // Tangent
+                    const tx = -ny;
+                    const ty = nx;
+
+                    // Normal velocity
+                    let bvx = pvx[i];
+                    let bvy = vy;
+                    const vn = bvx * nx + bvy * ny;
+
+                    if (vn > 0) {
+                        // Normal impulse: j/m simplifies to -(1+e)*vn
+                        const impulseN = -(1 + prn[i]) * vn;
+                        bvx += impulseN * nx;
+                        bvy += impulseN * ny;
+
+                        // Tangential relative velocity at contact
+                        const rB = prB[i];
+                        const vtBallSurf = (bvx * tx + bvy * ty) + (pw[i] * rB);
+                        const vtWallSurf = pcw[i] * rC;
+                        const vRelTan = vtBallSurf - vtWallSurf;
+
+                        // Tangential impulse
+                        const jt = -(1 + prt[i]) * vRelTan * pem[i];
+
+                        // Apply
+                        const jtInvMass = jt * pim[i];
+                        pvx[i] = bvx + jtInvMass * tx;
+                        pvy[i] = bvy + jtInvMass * ty;
+                        pw[i] += jt * rB * pib[i];
+                        pcw[i] -= jt * rC * pic[i];
+                    }
                 }
+            }
+        }
+    }
+
+    // Event-driven alternative to the sub-step loop. Between wall contacts a ball follows
+    // its exact parabola, so every system is advanced in closed form from event to event:
+    // at each event it is moved to the event time, bounced if it is on the wall, and its
+    // next event predicted (predictEvent). Events land in a calendar of EVENT_BUCKETS
+    // buckets over the step and are taken bucket by bucket, so all systems' contacts are
+    // processed in time order to within a bucket; a system only ever has one entry, and
+    // its next one is never earlier, so its own events stay exactly in order. Predictions
+    // reaching past the step carry over in F_NEXT_EVENT.
+    integrateEvents(dt, begin = 0, end = this.count) {
+        if (!this.eventTime) {
+            this.eventTime = new Float64Array(this.count);
+            this.eventNext = new Int32Array(this.count);
+            this.eventContacts = new Int32Array(this.count);
+        }
+        const time = this.eventTime; // system's own clock within the step
+        const next = this.eventNext; // bucket list links
+        const contacts = this.eventContacts;
+        const buckets = this.eventBuckets;
+        const nextEvent = this.nextEvent;
+        const width = dt / EVENT_BUCKETS;
+        buckets.fill(-1);
+
+        for (let i = begin; i < end; i++) {
+            time[i] = 0;
+            contacts[i] = 0;
+            if (nextEvent[i] === EVENT_RESTING) {
+                contacts[i] = EVENT_MAX_CONTACTS + 1;
+                continue;
+            }
+            const t = nextEvent[i] >= 0 ? nextEvent[i] : 0;
+            nextEvent[i] = t;
+            if (t >= dt) continue;
+            const b = Math.min(EVENT_BUCKETS - 1, Math.floor(t / width));
+            next[i] = buckets[b];
+            buckets[b] = i;
+        }
+
+        let processed = 0;
+        for (let b = 0; b < EVENT_BUCKETS; b++) {
+            // A bucket can refill while it is being taken.
+            while (buckets[b] >= 0) {
+                const i = buckets[b];
+                buckets[b] = next[i];
+                const t = nextEvent[i];
+                this.drift(i, t - time[i]);
+                time[i] = t;
+                processed++;
 
-                // Tangent
-                const tx = -ny;
-                const ty = nx;
-
-                // Normal velocity
-                const vn = b.vx * nx + b.vy * ny;
-
-                if (vn > 0) {
-                    // Normal impulse: j/m simplifies to -(1+e)*vn
-                    const impulseN = -(1 + RESTITUTION_NORMAL) * vn;
-                    b.vx += impulseN * nx;
-                    b.vy += impulseN * ny;
-
-                    // Tangential relative velocity at contact
-                    const vtBallSurf = (b.vx * tx + b.vy * ty) + (b.angularVelocity * rB);
-                    const vtWallSurf = c.angularVelocity * rC;
-                    const vRelTan = vtBallSurf - vtWallSurf;
-
-                    // Tangential impulse
-                    const jt = -(1 + RESTITUTION_TANGENT) * vRelTan * effMass;
-
-                    // Apply
-                    const jtInvMass = jt * invMass;
-                    b.vx += jtInvMass * tx;
-                    b.vy += jtInvMass * ty;
-                    b.angularVelocity += jt * rB * invInertiaB;
-                    c.angularVelocity -= jt * rC * invInertiaC;
+                let dist = this.touchingWall(i);
+                if (dist > 0) {
+                    this.collide(i, dist);
+                    if (++contacts[i] > EVENT_MAX_CONTACTS) {
+                        nextEvent[i] = dt;
+                        continue;
+                    }
                 }
+                const at = t + this.predictEvent(i, 2 * dt - t);
+                nextEvent[i] = at;
+                if (at >= dt) continue;
+                const bucket = Math.max(b, Math.min(EVENT_BUCKETS - 1, Math.floor(at / width)));
+                next[i] = buckets[bucket];
+                buckets[bucket] = i;
             }
         }
-        
-        const stats = this.calculateEnergy();
-        return this.correctEnergy(stats);
+        this.eventsProcessed += processed;
+
+        for (let i = begin; i < end; i++) {
+            if (contacts[i] > EVENT_MAX_CONTACTS) {
+                nextEvent[i] = this.subStepContact(i, time[i], dt) ? EVENT_RESTING : NaN;
+            } else {
+                this.drift(i, dt - time[i]);
+                nextEvent[i] -= dt;
+            }
+        }
+    }
+
+    // Runs system i from t to the end of the step through the sub-step kernel's
+    // integration and collision, at its sub-step length or a little under. Returns whether
+    // the ball was still on the wall in the last sub-step.
+    subStepContact(i, t, dt) {
+        const steps = Math.max(1, Math.ceil((dt - t) / dt * this.subSteps[i]));
+        const h = (dt - t) / steps;
+        const gh = this.gravity[i] * h;
+        const maxDistSq = this.maxDistSq[i];
+        let touching = false;
+        for (let s = 0; s < steps; s++) {
+            const vy = this.vy[i] + gh;
+            const x = this.x[i] + this.vx[i] * h;
+            const y = this.y[i] + vy * h;
+            this.vy[i] = vy;
+            this.x[i] = x;
+            this.y[i] = y;
+            this.angle[i] += this.angularVelocity[i] * h;
+            this.containerAngle[i] += this.containerAngularVelocity[i] * h;
+            const distSq = x * x + y * y;
+            touching = distSq >= maxDistSq;
+            if (touching) this.collide(i, Math.sqrt(distSq));
+        }
+        return touching;
+    }
+
+    // Advances system i along its contact-free trajectory by t.
+    drift(i, t) {
+        if (t <= 0) return;
+        const vy = this.vy[i];
+        const g = this.gravity[i];
+        this.x[i] += this.vx[i] * t;
+        this.y[i] += vy * t + 0.5 * g * t * t;
+        this.vy[i] = vy + g * t;
+        this.angle[i] += this.angularVelocity[i] * t;
+        this.containerAngle[i] += this.containerAngularVelocity[i] * t;
+    }
+
+    // Ball distance from the container centre when it is within EVENT_TOLERANCE of the
+    // wall (or past it), else 0.
+    touchingWall(i) {
+        const x = this.x[i];
+        const y = this.y[i];
+        const dist = Math.sqrt(x * x + y * y);
+        return dist >= this.maxDist[i] - EVENT_TOLERANCE ? dist : 0;
+    }
+
+    // The sub-step kernel's collision response for system i at distance `dist`: pushes the
+    // ball back onto the wall and applies the normal and tangential impulses.
+    collide(i, dist) {
+        const x = this.x[i];
+        const y = this.y[i];
+        const nx = x / dist;
+        const ny = y / dist;
+        const pen = dist - this.maxDist[i];
+        if (pen > 0) {
+            this.x[i] = x - nx * pen;
+            this.y[i] = y - ny * pen;
+        }
+
+        const tx = -ny;
+        const ty = nx;
+        let bvx = this.vx[i];
+        let bvy = this.vy[i];
+        const vn = bvx * nx + bvy * ny;
+        if (vn <= 0) return;
+
+        const impulseN = -(1 + this.restitutionNormal[i]) * vn;
+        bvx += impulseN * nx;
+        bvy += impulseN * ny;
+        const rB = this.ballRadius[i];
+        const rC = CONTAINER_RADIUS;
+        const vRelTan = (bvx * tx + bvy * ty) + this.angularVelocity[i] * rB - this.containerAngularVelocity[i] * rC;
+        const jt = -(1 + this.restitutionTangent[i]) * vRelTan * this.effMass[i];
+        const jtInvMass = jt * this.invMass[i];
+        this.vx[i] = bvx + jtInvMass * tx;
+        this.vy[i] = bvy + jtInvMass * ty;
+        this.angularVelocity[i] += jt * rB * this.invInertiaB[i];
+        this.containerAngularVelocity[i] -= jt * rC * this.invInertiaC[i];
+    }
+
+    // Time from system i's current state to its next event, at most `horizon`: the first
+    // wall contact when it is found, else how far the search proved the path clear.
+    //
+    // With f(t) = |p(t)|^2 - maxDist^2 (negative inside) and M >= |f''| over the horizon,
+    // f(t + d) <= f(t) + f'(t) d + M d^2 / 2, so the first root of that parabola is a safe
+    // advance. Far from the wall it takes large strides; approaching it, it converges like
+    // Newton's method from the inside. Leaving the wall after a bounce, f'(t) < 0 gives a
+    // positive first stride even at f = 0.
+    predictEvent(i, horizon) {
+        const x = this.x[i];
+        const y = this.y[i];
+        const vx = this.vx[i];
+        const vy = this.vy[i];
+        const g = this.gravity[i];
+        const maxDist = this.maxDist[i];
+        const limitSq = maxDist * maxDist;
+        const tolerance = 2 * maxDist * EVENT_TOLERANCE;
+        const speed = Math.sqrt(vx * vx + vy * vy) + Math.abs(g) * horizon;
+        const curvature = 2 * (speed * speed + (maxDist + EVENT_TOLERANCE) * Math.abs(g));
+        if (!(curvature > 0)) return horizon;
+
+        let t = 0;
+        for (let iter = 0; iter < EVENT_MAX_ITERATIONS; iter++) {
+            const px = x + vx * t;
+            const py = y + (vy + 0.5 * g * t) * t;
+            const f = Math.min(0, px * px + py * py - limitSq);
+            const slope = 2 * (px * vx + py * (vy + g * t));
+            if (t > 0 && f > -tolerance) return t;
+            t += (Math.sqrt(slope * slope - 2 * curvature * f) - slope) / curvature;
+            if (!(t < horizon)) return horizon;
+        }
+        return t;
+    }
+
+    // Applies the energy correction to [begin, end) and returns their summed energy.
+    // Adaptive stores also pick each system's next sub-step count here; `span` is the
+    // number of steps since the previous correction (see correctEvery in advance()).
+    //
+    // Totals use Neumaier's compensated sum: at 10^5 systems the naive sum's rounding is
+    // as large as the corrected drift the deviation readout is meant to show.
+    settleEnergy(begin = 0, end = this.count, dt = 0, span = 1) {
+        let sum = 0;
+        let compensation = 0;
+        for (let i = begin; i < end; i++) {
+            const total = this.calculateEnergy(i);
+            if (this.adaptive) this.adaptSubSteps(i, total, dt, span);
+            const e = this.correctEnergy(i, total);
+            const t = sum + e;
+            compensation += Math.abs(sum) >= Math.abs(e) ? (sum - t) + e : (e - t) + sum;
+            sum = t;
+        }
+        return sum + compensation;
+    }
+
+    // Summed energy of [begin, end) without correcting it.
+    measureEnergy(begin = 0, end = this.count) {
+        let sum = 0;
+        let compensation = 0;
+        for (let i = begin; i < end; i++) {
+            const e = this.calculateEnergy(i);
+            const t = sum + e;
+            compensation += Math.abs(sum) >= Math.abs(e) ? (sum - t) + e : (e - t) + sum;
+            sum = t;
+        }
+        return sum + compensation;
+    }
+
+    adaptSubSteps(i, total, dt, span = 1) {
+        const n = this.subSteps[i];
+        const initialEnergy = this.initialEnergy[i];
+        const error = initialEnergy > 0.000001 ? Math.abs(total - initialEnergy) / (initialEnergy * span) : 0;
+
+        // Dissipative systems lose energy by design, so only the contact bound applies.
+        let next = n;
+        const elastic = this.elastic[i] === 1;
+        if (elastic && error > this.accuracy) next = n * 2;
+        else if (elastic && error < this.accuracy * ADAPT_RELAX) next = Math.floor(n / 2);
+
+        const x = this.x[i];
+        const y = this.y[i];
+        const vx = this.vx[i];
+        const vy = this.vy[i];
+        const gap = Math.max(0, this.maxDist[i] - Math.sqrt(x * x + y * y));
+        const travel = Math.sqrt(vx * vx + vy * vy) * dt;
+        next = Math.max(next, Math.ceil(travel / (gap + CONTACT_SLOP)));
+
+        next = Math.max(MIN_SUB_STEPS, Math.min(MAX_SUB_STEPS, next));
+        if (next !== n) {
+            this.subSteps[i] = next;
+            this.deriveStepCoefficients(i);
+        }
     }
 
-    correctEnergy(stats) {
-        if (!this.initialEnergy || this.initialEnergy < 0.000001) return stats.total;
-        const currentKE = stats.total - stats.pe;
-        const targetKE = this.initialEnergy - stats.pe;
+    // Only elastic systems conserve energy; dissipative ensemble members are left alone.
+    correctEnergy(i, total) {
+        const initialEnergy = this.initialEnergy[i];
+        if (!initialEnergy || initialEnergy < 0.000001) return total;
+        if (this.elastic[i] === 0) return total;
+        const pe = this.potentialSlope[i] * this.y[i];
+        const currentKE = total - pe;
+        const targetKE = initialEnergy - pe;
 
         if (targetKE > 0.000001 && currentKE > 0.000001) {
             let scale = Math.sqrt(targetKE / currentKE);
@@ -157,110 +737,453 @@ class SimSystem {
             scale = Math.max(0.99, Math.min(1.01, scale));
             
             // Safety check for NaN/Infinity
-            if (!Number.isFinite(scale)) return stats.total;
+            if (!Number.isFinite(scale)) return total;
             
             if (scale !== 1) {
-                this.ball.vx *= scale;
-                this.ball.vy *= scale;
-                this.ball.angularVelocity *= scale;
-                this.container.angularVelocity *= scale;
+                this.vx[i] *= scale;
+                this.vy[i] *= scale;
+                this.angularVelocity[i] *= scale;
+                this.containerAngularVelocity[i] *= scale;
+                if (this.nextEvent[i] !== EVENT_RESTING) this.nextEvent[i] = NaN;
             }
 
-            return stats.pe + currentKE * scale * scale;
+            return pe + currentKE * scale * scale;
+        }
+
+        return total;
+    }
+
+    // Adds the position sums of [begin, end) and, with `analytics`, the divergence of its
+    // neighbour pairs into the reduction record at out[at] (see R_SUM_X..R_DIVERGED).
+    // Neighbours start INITIAL_SPREAD / numSystems apart, so ln(d / d0) over the elapsed
+    // time is the pair's finite-time Lyapunov estimate.
+    reduce(out, at, begin = 0, end = this.count, analytics = false) {
+        const px = this.x;
+        const py = this.y;
+        let sumX = 0;
+        let sumY = 0;
+        let sumDist = 0;
+        let logSeparation = 0;
+        let maxSeparation = 0;
+        let diverged = 0;
+        const logInitial = Math.log(INITIAL_SPREAD / numSystems);
+        for (let i = begin; i < end; i++) {
+            const x = px[i];
+            const y = py[i];
+            sumX += x;
+            sumY += y;
+            sumDist += Math.sqrt(x * x + y * y);
+            if (!analytics || i === begin) continue;
+
+            const dx = x - px[i - 1];
+            const dy = y - py[i - 1];
+            const d = Math.sqrt(dx * dx + dy * dy);
+            logSeparation += d > 0 ? Math.log(d) - logInitial : 0;
+            if (d > maxSeparation) maxSeparation = d;
+            if (d > DIVERGED_SEPARATION) diverged++;
         }
+        out[at + R_SUM_X] += sumX;
+        out[at + R_SUM_Y] += sumY;
+        out[at + R_SUM_DIST] += sumDist;
+        if (!analytics || end - begin < 2) return;
+        out[at + R_PAIRS] += end - begin - 1;
+        out[at + R_LOG_SEPARATION] += logSeparation;
+        out[at + R_MAX_SEPARATION] = Math.max(out[at + R_MAX_SEPARATION], maxSeparation);
+        out[at + R_DIVERGED] += diverged;
+    }
 
-        return stats.total;
+    // Writes the compact render state (STATE_STRIDE floats per system) of [begin, end) into out.
+    writeState(out, begin = 0, end = this.count) {
+        for (let i = begin; i < end; i++) {
+            const base = i * STATE_STRIDE;
+            out[base] = this.x[i];
+            out[base + 1] = this.y[i];
+            out[base + 2] = this.angle[i];
+            out[base + 3] = this.containerAngle[i];
+        }
     }
 }
 
 // Worker state
-let systems = [];
-let systemIds = [];
+let numSystems = 64; // size of the whole multiverse (not just this worker's slice)
+let ensemble = null; // buildEnsemble() table over the whole multiverse, when sweeping
+let store = new SystemStore([]);
+
+// Shared-memory exchange (set when init carries a shared arena; layout comes from the page)
+let sharedControl = null;
+let sharedControlF64 = null;
+let sharedLayout = null;
+let snapshotRing = null;
+let snapshotFloats = 0;
+let outOffset = 0;
+let doneIndex = 0;
+let reductionBase = 0; // this worker's REDUCTION_DOUBLES record for ring slot 0
+let lastSeq = 0;
+let sharedGeneration = 0; // bumped on resize so listeners on an old control block retire
+
+// Work-stealing scheduler (set when the page shares the whole store)
+let stealing = false;
+let parked = false; // outside the page's active worker count: sits batches out
+let stealChunk = 0;
+let stealChunks = 0;
+
+// Message-mode batch output (output-format.js), negotiated in init/resize
+let output = outputLayout({ groups: OUTPUT_DEFAULT_GROUPS, encoding: 'float32' });
+let outputColumns = []; // store column per output value
+let outputIsState = true; // float32 position + angles: exactly writeState()
+let outputPrevious = new Int16Array(0); // delta encoding: last value sent per system per value
+let outputKeyframe = true; // next delta batch is relative to 0
+
+function resetStore(begin = 0, end = store.count) {
+    for (let i = begin; i < end; i++) {
+        store.reset(i);
+    }
+    return store.measureEnergy(begin, end);
+}
+
+// Runs `steps` consecutive steps of dt and returns the energy after the last one.
+// `firstStep` counts the batch's first step since reset: with store.correctEvery = K the
+// energy pass (correction and adaptive controller) only runs after every Kth step of
+// that count, so it lands on the same steps however the run is batched or partitioned.
+// A batch ending between corrections measures its energy uncorrected.
+function advance(dt, steps, begin = 0, end = store.count, firstStep = 0) {
+    const k = store.correctEvery;
+    if (k <= 1) {
+        let totalEnergy = steps > 0 ? 0 : store.measureEnergy(begin, end);
+        for (let s = 0; s < steps; s++) {
+            totalEnergy = store.update(dt, begin, end);
+        }
+        return totalEnergy;
+    }
+
+    let totalEnergy = 0;
+    for (let s = 0; s < steps; s++) {
+        store.integrate(dt, begin, end);
+        if ((firstStep + s + 1) % k === 0) totalEnergy = store.settleEnergy(begin, end, dt, k);
+        else if (s === steps - 1) totalEnergy = store.measureEnergy(begin, end);
+    }
+    return steps > 0 ? totalEnergy : store.measureEnergy(begin, end);
+}
+
+// Divergence analytics run on batches that reach a multiple of analyticsEvery steps (0 = off).
+let analyticsEvery = 0;
+function sampleAnalytics(op, firstStep, steps) {
+    return analyticsEvery > 0 && op !== OP_RESET &&
+        Math.floor((firstStep + steps) / analyticsEvery) > Math.floor(firstStep / analyticsEvery);
+}
+
+function listenShared() {
+    const generation = sharedGeneration;
+    const result = Atomics.waitAsync(sharedControl, sharedLayout.seq, lastSeq);
+    if (!result.async) runShared();
+    else result.value.then(() => {
+        if (generation === sharedGeneration) runShared();
+    });
+}
+
+// Times `steps` steps of a scratch store of `count` freshly reset systems, configured like
+// the live one, for the page's pool sizing. Returns ms per system-step.
+function calibrateStepCost(count, steps) {
+    const live = store;
+    store = new SystemStore(Array.from({ length: count }, (_, i) => i % Math.max(1, numSystems)));
+    store.freeFlightSkip = live.freeFlightSkip;
+    store.adaptive = live.adaptive;
+    store.accuracy = live.accuracy;
+    store.correctEvery = live.correctEvery;
+    store.events = live.events;
+    resetStore();
+    advance(FIXED_DT, 2, 0, count, 0); // warm-up
+    const start = performance.now();
+    advance(FIXED_DT, steps, 0, count, 2);
+    const elapsed = performance.now() - start;
+    store = live;
+    return elapsed / (count * steps);
+}
+
+// Builds this worker's store for its slice and binds the shared arena, if any.
+function configure(msg) {
+    numSystems = msg.numSystems ?? numSystems;
+    stealing = Boolean(msg.shared?.storeBuffer);
+    parked = Boolean(msg.parked);
+    ensemble = msg.ensemble ? buildEnsemble(msg.ensemble, numSystems) : null;
+    store = new SystemStore(msg.systemIds ?? msg.data?.systemIds ?? [], msg.shared?.storeBuffer);
+    store.freeFlightSkip = msg.freeFlightSkip ?? true;
+    store.adaptive = Boolean(msg.adaptiveSubSteps);
+    store.accuracy = msg.subStepAccuracy ?? DEFAULT_SUB_STEP_ACCURACY;
+    store.correctEvery = Math.max(1, msg.correctEvery ?? 1);
+    store.events = Boolean(msg.eventIntegration);
+    analyticsEvery = msg.analyticsEvery ?? 0;
+    output = outputLayout(msg.output ?? { groups: OUTPUT_DEFAULT_GROUPS, encoding: 'float32' });
+    outputColumns = output.names.map((name) => store[name]);
+    outputIsState = output.encoding === 'float32' && output.names.join() === 'x,y,angle,containerAngle';
+    outputPrevious = new Int16Array(store.count * output.names.length);
+    outputKeyframe = true;
+    if (stealing) {
+        stealChunk = msg.shared.stealChunk;
+        stealChunks = Math.ceil(store.count / stealChunk);
+    }
+    if (msg.shared) {
+        const { snapshotBuffer, controlBuffer, layout, slot } = msg.shared;
+        snapshotRing = new Float32Array(snapshotBuffer);
+        snapshotFloats = msg.shared.snapshotFloats;
+        outOffset = (store.count > 0 ? store.ids[0] : 0) * STATE_STRIDE;
+        sharedControl = new Int32Array(controlBuffer);
+        sharedControlF64 = new Float64Array(controlBuffer);
+        sharedLayout = layout;
+        doneIndex = (layout.doneOffset >> 2) + slot;
+        reductionBase = (layout.reductionOffset >> 3) + slot * layout.slots * REDUCTION_DOUBLES;
+        // Batch IDs keep counting across resizes.
+        lastSeq = msg.baseBatchId ?? 0;
+        sharedGeneration++;
+        listenShared();
+    }
+}
+
+function commandByte(batchId) {
+    return sharedLayout.commandOffset + (batchId % sharedLayout.slots) * sharedLayout.commandBytes;
+}
+
+// Claims chunks of batch b from the slot's shared counter until none are left. Every
+// worker runs every batch, so a chunk may still be finishing batch b - 1 elsewhere. A
+// worker that falls behind can find the slot already reused by a newer batch; the claim
+// word carries its batch's tag, so it then claims nothing.
+function runStolenBatch(b) {
+    const batchDoneIndex = sharedLayout.batchDoneOffset >> 2;
+    if (Atomics.load(sharedControl, batchDoneIndex) >= b) return;
+
+    const tag = (b & CLAIM_TAG_MASK) << CLAIM_CHUNK_BITS;
+    const slot = b % sharedLayout.slots;
+    const claimIndex = (sharedLayout.claimOffset >> 2) + slot;
+    const remainingIndex = (sharedLayout.remainingOffset >> 2) + slot;
+    const chunkDoneBase = sharedLayout.chunkDoneOffset >> 2;
+    const out = snapshotRing.subarray(slot * snapshotFloats, (slot + 1) * snapshotFloats);
+    const reduction = reductionBase + slot * REDUCTION_DOUBLES;
+    let op = 0; // read with the first claim
+    let steps = 0;
+    let dt = 0;
+    let firstStep = 0;
+    let energy = 0;
+    let compensation = 0;
+
+    for (;;) {
+        const claimed = Atomics.load(sharedControl, claimIndex);
+        const chunk = claimed & CLAIM_CHUNK_MASK;
+        if ((claimed & ~CLAIM_CHUNK_MASK) !== tag || chunk >= stealChunks) break;
+        if (Atomics.compareExchange(sharedControl, claimIndex, claimed, claimed + 1) !== claimed) continue;
+
+        // Batch b can't finish, nor its slot be reused, while this chunk is claimed.
+        if (op === 0) {
+            const cmd = commandByte(b);
+            op = sharedControl[cmd >> 2];
+            steps = sharedControl[(cmd >> 2) + 1];
+            dt = sharedControlF64[(cmd >> 3) + 1];
+            firstStep = sharedControlF64[(cmd >> 3) + 2];
+        }
+
+        const chunkIndex = chunkDoneBase + chunk;
+        let done;
+        while ((done = Atomics.load(sharedControl, chunkIndex)) < b - 1) {
+            Atomics.wait(sharedControl, chunkIndex, done);
+        }
+
+        const begin = chunk * stealChunk;
+        const end = Math.min(begin + stealChunk, store.count);
+        const e = op === OP_RESET ? resetStore(begin, end) : advance(dt, steps, begin, end, firstStep);
+        const t = energy + e;
+        compensation += Math.abs(energy) >= Math.abs(e) ? (energy - t) + e : (e - t) + energy;
+        energy = t;
+        // Published before the chunk is counted, like the state.
+        sharedControlF64[reduction + R_ENERGY] = energy + compensation;
+        store.reduce(sharedControlF64, reduction, begin, end, sampleAnalytics(op, firstStep, steps));
+        store.writeState(out, begin, end);
+
+        // Count the chunk before releasing it, so batch b always finishes before b + 1.
+        if (Atomics.sub(sharedControl, remainingIndex, 1) === 1) raiseTo(batchDoneIndex, b);
+        raiseTo(chunkIndex, b);
+    }
+}
+
+// Raises a shared "newest batch" word to b (never lowers it) and wakes its waiters.
+function raiseTo(index, b) {
+    let current;
+    while ((current = Atomics.load(sharedControl, index)) < b &&
+        Atomics.compareExchange(sharedControl, index, current, b) !== current) {}
+    Atomics.notify(sharedControl, index);
+}
+
+// Runs every batch published since the last wake-up, in order, writing each into its
+// ring slot. With static slices, batches older than the newest pending reset are skipped.
+function runShared() {
+    const seq = Atomics.load(sharedControl, sharedLayout.seq);
+    if (seq !== lastSeq && parked) {
+        // The page neither hands a parked worker chunks nor waits for it.
+        if (!stealing) Atomics.store(sharedControl, doneIndex, seq);
+        lastSeq = seq;
+    } else if (seq !== lastSeq && stealing) {
+        for (let b = lastSeq + 1; b <= seq; b++) {
+            runStolenBatch(b);
+        }
+        lastSeq = seq;
+    } else if (seq !== lastSeq) {
+        let first = lastSeq + 1;
+        for (let b = seq; b > lastSeq; b--) {
+            if (sharedControl[commandByte(b) >> 2] === OP_RESET) {
+                first = b;
+                break;
+            }
+        }
+
+        for (let b = first; b <= seq; b++) {
+            const cmd = commandByte(b);
+            const slot = b % sharedLayout.slots;
+            const totalEnergy = sharedControl[cmd >> 2] === OP_RESET
+                ? resetStore()
+                : advance(sharedControlF64[(cmd >> 3) + 1], sharedControl[(cmd >> 2) + 1], 0, store.count,
+                    sharedControlF64[(cmd >> 3) + 2]);
+            const out = slot * snapshotFloats + outOffset;
+            store.writeState(snapshotRing.subarray(out, out + store.count * STATE_STRIDE));
+
+            const reduction = reductionBase + slot * REDUCTION_DOUBLES;
+            sharedControlF64.fill(0, reduction, reduction + REDUCTION_DOUBLES);
+            sharedControlF64[reduction + R_ENERGY] = totalEnergy;
+            store.reduce(sharedControlF64, reduction, 0, store.count,
+                sampleAnalytics(sharedControl[cmd >> 2], sharedControlF64[(cmd >> 3) + 2], sharedControl[(cmd >> 2) + 1]));
+            Atomics.store(sharedControl, doneIndex, b);
+        }
+        Atomics.notify(sharedControl, doneIndex);
+        lastSeq = seq;
+    }
+    listenShared();
+}
+
+// Encodes the negotiated output of every system after the batch header and returns the
+// bytes written (see output-format.js).
+function writeOutput(buffer) {
+    const count = store.count;
+    const { encoding, quanta, wraps } = output;
+    const values = quanta.length;
+    const columns = outputColumns;
+    if (encoding === 'float32') {
+        const out = new Float32Array(buffer, BATCH_HEADER_BYTES, count * values);
+        if (outputIsState) store.writeState(out);
+        else {
+            for (let i = 0; i < count; i++) {
+                for (let v = 0; v < values; v++) out[i * values + v] = columns[v][i];
+            }
+        }
+        return count * values * 4;
+    }
+
+    const int16 = encoding === 'int16' ? new Int16Array(buffer, BATCH_HEADER_BYTES, count * values) : null;
+    const bytes = int16 ? null : new Uint8Array(buffer, BATCH_HEADER_BYTES);
+    const previous = outputPrevious;
+    if (outputKeyframe) previous.fill(0);
+    let p = 0;
+    for (let i = 0; i < count; i++) {
+        for (let v = 0; v < values; v++) {
+            const k = i * values + v;
+            const scaled = Math.round(columns[v][i] / quanta[v]);
+            const q = wraps[v] ? (scaled << 16) >> 16 : Math.max(-OUTPUT_INT16_MAX, Math.min(OUTPUT_INT16_MAX, scaled));
+            if (int16) {
+                int16[k] = q;
+                continue;
+            }
+            // Wrapped int16 difference, zigzag, base-128
+            const d = ((q - previous[k]) << 16) >> 16;
+            previous[k] = q;
+            let z = d >= 0 ? d * 2 : -d * 2 - 1;
+            while (z >= 128) {
+                bytes[p++] = (z & 127) | 128;
+                z >>>= 7;
+            }
+            bytes[p++] = z;
+        }
+    }
+    return int16 ? count * values * 2 : p;
+}
+
+const batchTransfer = [null]; // reused transfer list for batch replies
+
+function runBatch(buffer) {
+    const outputBytes = BATCH_HEADER_BYTES + store.count * output.names.length * output.valueBytes;
+    if (buffer.byteLength !== outputBytes) {
+        // Only a buffer sized for another partition; answer in a fresh one.
+        const fresh = new ArrayBuffer(outputBytes);
+        new Float64Array(fresh, 0, BATCH_HEADER_DOUBLES).set(new Float64Array(buffer, 0, BATCH_HEADER_DOUBLES));
+        buffer = fresh;
+    }
+    const header = new Float64Array(buffer, 0, BATCH_HEADER_DOUBLES);
+    const isReset = header[BATCH_OP] === OP_RESET;
+    header.fill(0, BATCH_REDUCTION, BATCH_REDUCTION + REDUCTION_DOUBLES);
+    header[BATCH_REDUCTION + R_ENERGY] = isReset
+        ? resetStore()
+        : advance(header[BATCH_DT], header[BATCH_STEPS], 0, store.count, header[BATCH_FIRST_STEP]);
+    store.reduce(header, BATCH_REDUCTION, 0, store.count,
+        sampleAnalytics(header[BATCH_OP], header[BATCH_FIRST_STEP], header[BATCH_STEPS]));
+    if (isReset) outputKeyframe = true;
+    header[BATCH_KEYFRAME] = outputKeyframe ? 1 : 0;
+    header[BATCH_PAYLOAD_BYTES] = writeOutput(buffer);
+    outputKeyframe = false;
+
+    batchTransfer[0] = buffer;
+    self.postMessage(buffer, batchTransfer);
+    batchTransfer[0] = null;
+}
 
 // Message handler
 self.onmessage = function(e) {
     const msg = e.data;
+    if (msg instanceof ArrayBuffer) {
+        runBatch(msg);
+        return;
+    }
     const type = msg?.type;
     
     switch(type) {
         case 'init':
-            // Initialize systems for this worker
-            systemIds = msg.systemIds ?? msg.data?.systemIds ?? [];
-            systems = systemIds.map((id) => new SimSystem(id));
-            self.postMessage({ type: 'initialized' });
+        case 'resize':
+            // (Re)initialize systems for this worker without recreating it
+            configure(msg);
+            self.postMessage({ type: type === 'init' ? 'initialized' : 'resized' });
             break;
             
-        case 'update':
-            // Update all systems and write compact state to an output buffer.
-            {
-                const dt = msg.dt ?? msg.data?.dt;
-                const batchId = msg.batchId;
-                const expectedFloats = systems.length * STATE_STRIDE;
-                let buffer = msg.buffer;
-                if (!(buffer instanceof ArrayBuffer) || buffer.byteLength !== expectedFloats * 4) {
-                    buffer = new ArrayBuffer(expectedFloats * 4);
-                }
-
-                const out = new Float32Array(buffer);
-                let totalEnergy = 0;
-
-                for (let i = 0; i < systems.length; i++) {
-                    const s = systems[i];
-                    totalEnergy += s.update(dt);
+        case 'ping':
+            // Round-trip probe for bench.js and the page's pool calibration
+            self.postMessage({ type: 'pong', sentAt: msg.sentAt });
+            break;
 
-                    const base = i * STATE_STRIDE;
-                    out[base] = s.ball.x;
-                    out[base + 1] = s.ball.y;
-                    out[base + 2] = s.ball.angle;
-                    out[base + 3] = s.container.angle;
-                }
+        case 'calibrate':
+            self.postMessage({ type: 'calibrated', systemStepMs: calibrateStepCost(msg.systems, msg.steps) });
+            break;
 
-                self.postMessage(
-                    {
-                        type: 'updated',
-                        batchId,
-                        buffer,
-                        totalEnergy
-                    },
-                    [buffer]
-                );
+        case 'snapshot':
+            // Copy of this worker's whole store (field-major doubles) for the page's snapshot blob.
+            {
+                const data = store.data.slice();
+                self.postMessage({ type: 'snapshot', data: data.buffer }, [data.buffer]);
             }
             break;
-            
-        case 'reset':
-            {
-                const batchId = msg.batchId;
-                const expectedFloats = systems.length * STATE_STRIDE;
-                let buffer = msg.buffer;
-                if (!(buffer instanceof ArrayBuffer) || buffer.byteLength !== expectedFloats * 4) {
-                    buffer = new ArrayBuffer(expectedFloats * 4);
-                }
-
-                const out = new Float32Array(buffer);
-                let totalEnergy = 0;
-
-                for (let i = 0; i < systems.length; i++) {
-                    const s = systems[i];
-                    s.reset(s.id);
-                    totalEnergy += s.initialEnergy;
 
-                    const base = i * STATE_STRIDE;
-                    out[base] = s.ball.x;
-                    out[base + 1] = s.ball.y;
-                    out[base + 2] = s.ball.angle;
-                    out[base + 3] = s.container.angle;
-                }
-
-                self.postMessage(
-                    {
-                        type: 'reset',
-                        batchId,
-                        buffer,
-                        totalEnergy
-                    },
-                    [buffer]
-                );
-            }
+        case 'restore':
+            // Replaces the store with a snapshot slice in the same layout. The page follows up
+            // with a zero-step update to publish the restored state.
+            store.data.set(new Float64Array(msg.data));
+            outputKeyframe = true;
+            self.postMessage({ type: 'restored' });
             break;
     }
 };
+
+if (typeof module !== 'undefined' && module.exports) {
+    module.exports = {
+        SystemStore,
+        configure,
+        advance,
+        get store() { return store; },
+        FIXED_DT,
+        OP_UPDATE,
+        OP_RESET,
+        BATCH_HEADER_DOUBLES,
+        BATCH_PAYLOAD_BYTES
+    };
+}
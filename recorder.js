@@ -0,0 +1,239 @@
+// Trajectory Recorder
+// Streams every Nth step's state record (STATE_STRIDE floats) for a set of systems into a
+// chunked binary format. Records are written into a small pool of preallocated chunks and
+// full chunks are handed to a sink asynchronously, so recording never allocates per step
+// and never waits on the sink: with every chunk still in flight, records are dropped.
+//
+// Layout (little endian):
+//   header  0   u32 magic 'RLTR', u16 version, u16 fields per record
+//           8   u32 system count, u32 every (steps between records)
+//           16  f64 FIXED_DT
+//           24  f32 position quantum, f32 angle quantum
+//           32  u32[system count] system IDs
+//   chunk   0   u32 byte length (including this header), u32 record count
+//           8   f64 step of the first record; the rest follow every `every` steps
+//           16  records: per system, per field, zigzag varint of the quantised value minus
+//               the same system/field in the previous record (0 before the first)
+// Each chunk decodes on its own; a reset or dropped records start a new chunk.
+
+const REC_MAGIC = 0x52544c52; // 'RLTR'
+const REC_VERSION = 1;
+const REC_FIELDS = 4; // ballX, ballY, ballAngle, containerAngle (must match engine STATE_STRIDE)
+const REC_HEADER_BYTES = 32;
+const REC_CHUNK_HEADER_BYTES = 16;
+const REC_CHUNK_BYTES = 256 * 1024;
+const REC_POOL_CHUNKS = 4;
+const REC_MAX_VALUE_BYTES = 8; // varint bound for |quantised delta| < 2^55
+const REC_POSITION_QUANTUM = 1 / 256; // px
+const REC_ANGLE_QUANTUM = 1 / 65536; // rad
+
+class TrajectoryRecorder {
+    // sink: { write(Uint8Array) -> Promise, close() -> Promise }. Written bytes are only
+    // reused once write() settles.
+    constructor(systemIds, every, dt, sink) {
+        this.systemIds = Uint32Array.from(systemIds);
+        this.every = every;
+        this.sink = sink;
+        this.records = 0;
+        this.bytes = 0;
+        this.dropped = 0;
+
+        const count = this.systemIds.length;
+        this.quanta = new Float64Array(REC_FIELDS);
+        this.quanta.fill(REC_POSITION_QUANTUM, 0, 2);
+        this.quanta.fill(REC_ANGLE_QUANTUM, 2);
+        this.previous = new Float64Array(count * REC_FIELDS);
+        this.recordBound = count * REC_FIELDS * REC_MAX_VALUE_BYTES;
+        const chunkBytes = Math.max(REC_CHUNK_BYTES, REC_CHUNK_HEADER_BYTES + this.recordBound);
+        this.free = [];
+        for (let c = 0; c < REC_POOL_CHUNKS; c++) this.free.push(new Uint8Array(chunkBytes));
+        this.chunk = null;
+        this.chunkView = null;
+        this.chunkRecords = 0;
+        this.offset = 0;
+        this.nextStep = -1; // step the open chunk expects next
+
+        const header = new ArrayBuffer(REC_HEADER_BYTES + count * 4);
+        const view = new DataView(header);
+        view.setUint32(0, REC_MAGIC, true);
+        view.setUint16(4, REC_VERSION, true);
+        view.setUint16(6, REC_FIELDS, true);
+        view.setUint32(8, count, true);
+        view.setUint32(12, every, true);
+        view.setFloat64(16, dt, true);
+        view.setFloat32(24, REC_POSITION_QUANTUM, true);
+        view.setFloat32(28, REC_ANGLE_QUANTUM, true);
+        new Uint32Array(header, REC_HEADER_BYTES).set(this.systemIds);
+        this.write(new Uint8Array(header));
+    }
+
+    // Appends the record for `step` from a state array indexed [id * REC_FIELDS + field].
+    record(step, state) {
+        if (this.chunk && (step !== this.nextStep || this.chunk.length - this.offset < this.recordBound)) {
+            this.flush();
+        }
+        if (!this.chunk) {
+            if (this.free.length === 0) {
+                this.dropped++;
+                return;
+            }
+            this.chunk = this.free.pop();
+            this.chunkView = new DataView(this.chunk.buffer);
+            this.chunkView.setFloat64(8, step, true);
+            this.chunkRecords = 0;
+            this.offset = REC_CHUNK_HEADER_BYTES;
+            this.previous.fill(0);
+        }
+
+        const out = this.chunk;
+        const ids = this.systemIds;
+        const quanta = this.quanta;
+        const previous = this.previous;
+        let p = this.offset;
+        for (let s = 0; s < ids.length; s++) {
+            const base = ids[s] * REC_FIELDS;
+            for (let f = 0; f < REC_FIELDS; f++) {
+                const q = Math.round(state[base + f] / quanta[f]);
+                const k = s * REC_FIELDS + f;
+                const delta = q - previous[k];
+                previous[k] = q;
+                // Zigzag and base-128 in double arithmetic: quantised angles outgrow 32 bits.
+                let z = delta >= 0 ? delta * 2 : -delta * 2 - 1;
+                while (z >= 128) {
+                    out[p++] = (z % 128) | 128;
+                    z = Math.floor(z / 128);
+                }
+                out[p++] = z;
+            }
+        }
+        this.offset = p;
+        this.chunkRecords++;
+        this.records++;
+        this.nextStep = step + this.every;
+    }
+
+    // Hands the open chunk to the sink; it rejoins the pool once written.
+    flush() {
+        const chunk = this.chunk;
+        if (!chunk) return;
+        this.chunkView.setUint32(0, this.offset, true);
+        this.chunkView.setUint32(4, this.chunkRecords, true);
+        this.write(chunk.subarray(0, this.offset)).then(() => this.free.push(chunk));
+        this.chunk = null;
+        this.chunkView = null;
+    }
+
+    // Bytes recorded so far, including the open chunk.
+    get length() {
+        return this.bytes + (this.chunk ? this.offset : 0);
+    }
+
+    write(bytes) {
+        this.bytes += bytes.length;
+        return this.sink.write(bytes).catch((err) => console.warn('Recorder write failed:', err.message));
+    }
+
+    // Flushes the open chunk and closes the sink.
+    stop() {
+        this.flush();
+        return this.sink.close();
+    }
+}
+
+// Sink over a WritableStream of Uint8Array chunks (e.g. a FileSystemWritableFileStream).
+function recorderStreamSink(stream) {
+    const writer = stream.getWriter();
+    return {
+        write: (bytes) => writer.write(bytes),
+        close: () => writer.close()
+    };
+}
+
+// Sink writing a file in the origin private file system.
+function recorderOpfsSink(name) {
+    const opened = navigator.storage.getDirectory()
+        .then((dir) => dir.getFileHandle(name, { create: true }))
+        .then((file) => file.createWritable());
+    let tail = opened;
+    const chain = (fn) => (tail = tail.then(fn));
+    return {
+        write: (bytes) => opened.then((stream) => chain(() => stream.write(bytes))),
+        close: () => opened.then((stream) => chain(() => stream.close()))
+    };
+}
+
+// Sink collecting the recording in memory and handing it to saveFile(name, buffer) on close.
+function recorderDownloadSink(name, saveFile) {
+    const parts = [];
+    let length = 0;
+    return {
+        write: (bytes) => {
+            parts.push(bytes.slice());
+            length += bytes.length;
+            return Promise.resolve();
+        },
+        close: () => {
+            const out = new Uint8Array(length);
+            let offset = 0;
+            for (const part of parts) {
+                out.set(part, offset);
+                offset += part.length;
+            }
+            saveFile(name, out.buffer);
+            return Promise.resolve();
+        }
+    };
+}
+
+// Decodes a recording into { systemIds, every, dt, steps, states }, where states holds
+// REC_FIELDS floats per system per record: [(record * systemIds.length + s) * fields + f].
+function decodeTrajectory(buffer) {
+    const view = new DataView(buffer);
+    if (buffer.byteLength < REC_HEADER_BYTES || view.getUint32(0, true) !== REC_MAGIC ||
+        view.getUint16(4, true) !== REC_VERSION || view.getUint16(6, true) !== REC_FIELDS) {
+        throw new Error('Not a trajectory recording');
+    }
+    const fields = REC_FIELDS;
+    const count = view.getUint32(8, true);
+    const every = view.getUint32(12, true);
+    const dt = view.getFloat64(16, true);
+    const quanta = [view.getFloat32(24, true), view.getFloat32(24, true), view.getFloat32(28, true), view.getFloat32(28, true)];
+    const systemIds = new Uint32Array(buffer.slice(REC_HEADER_BYTES, REC_HEADER_BYTES + count * 4));
+    const bytes = new Uint8Array(buffer);
+
+    let total = 0;
+    for (let at = REC_HEADER_BYTES + count * 4; at < buffer.byteLength; at += view.getUint32(at, true)) {
+        total += view.getUint32(at + 4, true);
+    }
+    const steps = new Float64Array(total);
+    const states = new Float32Array(total * count * fields);
+    const previous = new Float64Array(count * fields);
+
+    let r = 0;
+    for (let at = REC_HEADER_BYTES + count * 4; at < buffer.byteLength; at += view.getUint32(at, true)) {
+        const records = view.getUint32(at + 4, true);
+        const first = view.getFloat64(at + 8, true);
+        let p = at + REC_CHUNK_HEADER_BYTES;
+        previous.fill(0);
+        for (let k = 0; k < records; k++, r++) {
+            steps[r] = first + k * every;
+            for (let v = 0; v < count * fields; v++) {
+                let z = 0;
+                let scale = 1;
+                let b;
+                do {
+                    b = bytes[p++];
+                    z += (b & 127) * scale;
+                    scale *= 128;
+                } while (b & 128);
+                previous[v] += z % 2 === 0 ? z / 2 : -(z + 1) / 2;
+                states[r * count * fields + v] = previous[v] * quanta[v % fields];
+            }
+        }
+    }
+    return { systemIds, every, dt, steps, states };
+}
+
+if (typeof module !== 'undefined' && module.exports) {
+    module.exports = { TrajectoryRecorder, recorderStreamSink, recorderDownloadSink, decodeTrajectory };
+}
@@ -0,0 +1,63 @@
+// Render Worker: runs engine.js off the main thread on the page's transferred canvases.
+// The physics workers are created from here, so in shared mode the snapshot ring is read
+// straight from shared memory and the page is left with input and the stat panel.
+
+importScripts('renderer-gl.js', 'ensemble.js', 'output-format.js', 'recorder.js', 'engine.js');
+
+let viewport = null;
+
+// Stat panel writes are collected over a frame and posted once on commit().
+let pendingText = {};
+let pendingVisible = {};
+let pendingTitle;
+let pendingUi = false;
+
+const workerUi = {
+    text(id, value) {
+        pendingText[id] = value;
+        pendingUi = true;
+    },
+    visible(id, shown) {
+        pendingVisible[id] = shown;
+        pendingUi = true;
+    },
+    title(value) {
+        pendingTitle = value;
+        pendingUi = true;
+    },
+    commit() {
+        if (!pendingUi) return;
+        self.postMessage({ text: pendingText, visible: pendingVisible, title: pendingTitle });
+        pendingText = {};
+        pendingVisible = {};
+        pendingTitle = undefined;
+        pendingUi = false;
+    }
+};
+
+self.onmessage = (e) => {
+    const msg = e.data;
+    switch (msg.type) {
+        case 'start':
+            viewport = msg.viewport;
+            startEngine({
+                canvas: msg.canvas,
+                graphCanvas: msg.graphCanvas,
+                viewport: () => viewport,
+                ui: workerUi,
+                saveFile: (name, buffer) => self.postMessage({ file: { name, buffer } }, [buffer])
+            });
+            // Nothing is drawn until the pool is initialized; flush the panel now.
+            workerUi.commit();
+            break;
+        case 'viewport':
+            viewport = msg.viewport;
+            resize();
+            break;
+        case 'command':
+            runEngineCommand(msg.name, msg.arg);
+            // Commands may arrive between frames (or before the first one).
+            workerUi.commit();
+            break;
+    }
+};
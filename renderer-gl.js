@@ -0,0 +1,355 @@
+// WebGL2 Renderer
+// Draws containers, trails and balls in one instanced draw per pass. Per-instance data is
+// the engine's stateView (STATE_STRIDE floats per system) uploaded as-is; grid centres, the
+// overlay blend and trail colours are derived from gl_InstanceID in the shaders.
+//
+// Trails live in a GPU ring of TRAIL_LENGTH rows, one (x, y) per system per row. Every
+// system gains a trail point on the same frame, so one row upload per frame keeps the ring
+// current and segments between consecutive rows are drawn as instanced quads.
+
+const GL_CONTAINER_RADIUS = 300; // must match engine/worker
+const GL_BALL_RADIUS = 30;
+const GL_STATE_STRIDE = 4;
+const GL_TRAIL_LENGTH = 200;
+
+const GL_COMMON = `#version 300 es
+precision highp float;
+precision highp int;
+uniform vec2 u_viewport;
+uniform float u_t;
+uniform float u_layoutScale;
+uniform float u_overlayScale;
+uniform vec2 u_overlayCenter;
+uniform vec2 u_cell;
+uniform int u_gridCols;
+uniform int u_numSystems;
+
+vec2 systemCenter(int i) {
+    vec2 grid = vec2(float(i % u_gridCols), float(i / u_gridCols)) * u_cell + u_cell * 0.5;
+    return mix(grid, u_overlayCenter, u_t);
+}
+
+float systemScale() {
+    return mix(u_layoutScale, u_overlayScale, u_t);
+}
+
+vec4 toClip(vec2 px) {
+    return vec4(px.x / u_viewport.x * 2.0 - 1.0, 1.0 - px.y / u_viewport.y * 2.0, 0.0, 1.0);
+}
+`;
+
+// Rotated-frame helpers: v_rot carries (cos, sin) of the canvas rotation, and
+// unrotate() maps a local point back into that frame.
+const GL_ROTATED_FRAGMENT = `#version 300 es
+precision highp float;
+uniform float u_alpha;
+in vec2 v_local;
+flat in vec2 v_rot;
+out vec4 outColor;
+
+vec2 unrotate(vec2 p) {
+    return vec2(v_rot.x * p.x + v_rot.y * p.y, -v_rot.y * p.x + v_rot.x * p.y);
+}
+`;
+
+const GL_CONTAINER_VERTEX = GL_COMMON + `
+layout(location = 0) in vec2 a_corner;
+layout(location = 1) in vec4 a_state; // ballX, ballY, ballAngle, containerAngle
+out vec2 v_local;
+flat out vec2 v_rot;
+
+void main() {
+    v_local = a_corner * (${GL_CONTAINER_RADIUS.toFixed(1)} + 3.0);
+    v_rot = vec2(cos(a_state.w), sin(a_state.w));
+    gl_Position = toClip(systemCenter(gl_InstanceID) + v_local * systemScale());
+}
+`;
+
+const GL_CONTAINER_FRAGMENT = GL_ROTATED_FRAGMENT + `
+void main() {
+    const float R = ${GL_CONTAINER_RADIUS.toFixed(1)};
+    vec2 p = unrotate(v_local);
+    if ((abs(p.y) <= 1.0 && abs(p.x) <= R) || (abs(p.x) <= 1.0 && abs(p.y) <= R)) {
+        outColor = vec4(vec3(0x33) / 255.0, u_alpha);
+        return;
+    }
+    float d = abs(length(v_local) - R) - 2.0;
+    float coverage = 1.0 - smoothstep(-fwidth(d), fwidth(d), d);
+    if (coverage <= 0.0) discard;
+    outColor = vec4(vec3(0x55) / 255.0, u_alpha * coverage);
+}
+`;
+
+const GL_BALL_VERTEX = GL_COMMON + `
+layout(location = 0) in vec2 a_corner;
+layout(location = 1) in vec4 a_state;
+layout(location = 2) in float a_radius;
+out vec2 v_local;
+flat out vec2 v_rot;
+flat out float v_radius;
+
+void main() {
+    v_radius = a_radius;
+    v_local = a_corner * (a_radius + 2.0);
+    v_rot = vec2(cos(a_state.z), sin(a_state.z));
+    gl_Position = toClip(systemCenter(gl_InstanceID) + (a_state.xy + v_local) * systemScale());
+}
+`;
+
+const GL_BALL_FRAGMENT = GL_ROTATED_FRAGMENT + `
+flat in float v_radius;
+
+void main() {
+    float R = v_radius;
+    vec2 p = unrotate(v_local);
+    if (p.x >= 0.0 && p.x <= R && abs(p.y) <= 1.5) {
+        outColor = vec4(0.0, 0.0, 0.0, u_alpha);
+        return;
+    }
+    float d = length(v_local) - R;
+    float coverage = 1.0 - smoothstep(-fwidth(d), fwidth(d), d);
+    if (coverage <= 0.0) discard;
+    outColor = vec4(vec3(0xee) / 255.0, u_alpha * coverage);
+}
+`;
+
+const GL_TRAIL_VERTEX = GL_COMMON + `
+layout(location = 0) in vec2 a_corner; // x: 0 = from, 1 = to; y: side
+layout(location = 1) in vec2 a_from;
+layout(location = 2) in vec2 a_to;
+out vec3 v_color;
+
+vec3 hsl(float h, float s, float l) {
+    vec3 k = mod(vec3(0.0, 8.0, 4.0) + h * 12.0, 12.0);
+    float a = s * min(l, 1.0 - l);
+    return l - a * clamp(min(k - 3.0, 9.0 - k), -1.0, 1.0);
+}
+
+void main() {
+    // Instances start on a ring row boundary, so the system index wraps with the row.
+    int i = gl_InstanceID % u_numSystems;
+    vec2 dir = a_to - a_from;
+    float len = length(dir);
+    vec2 along = len > 0.0 ? dir / len : vec2(1.0, 0.0);
+    vec2 normal = vec2(-along.y, along.x);
+    // Half the 2D path's lineWidth of 3, with square ends to close the joins.
+    vec2 local = mix(a_from, a_to, a_corner.x) + normal * (a_corner.y * 1.5)
+        + along * ((a_corner.x * 2.0 - 1.0) * 1.5);
+    gl_Position = toClip(systemCenter(i) + local * systemScale());
+    v_color = hsl(float(i) / float(u_numSystems), 0.7, 0.6);
+}
+`;
+
+const GL_TRAIL_FRAGMENT = `#version 300 es
+precision highp float;
+uniform float u_alpha;
+in vec3 v_color;
+out vec4 outColor;
+
+void main() {
+    outColor = vec4(v_color, u_alpha);
+}
+`;
+
+class GlRenderer {
+    constructor(gl) {
+        this.gl = gl;
+        this.numSystems = 0;
+        this.trailHead = 0;
+        this.trailSize = 0;
+        this.trailRow = null;
+
+        this.containerProgram = this.createProgram(GL_CONTAINER_VERTEX, GL_CONTAINER_FRAGMENT);
+        this.ballProgram = this.createProgram(GL_BALL_VERTEX, GL_BALL_FRAGMENT);
+        this.trailProgram = this.createProgram(GL_TRAIL_VERTEX, GL_TRAIL_FRAGMENT);
+
+        this.quadBuffer = this.createBuffer(new Float32Array([-1, -1, 1, -1, -1, 1, 1, 1]));
+        this.segmentBuffer = this.createBuffer(new Float32Array([0, -1, 1, -1, 0, 1, 1, 1]));
+        this.stateBuffer = gl.createBuffer();
+        this.radiusBuffer = gl.createBuffer();
+        this.trailBuffer = gl.createBuffer();
+
+        // Containers and balls read the same quad and state buffers; balls also take a
+        // per-instance radius (see setBallRadii).
+        this.stateVao = gl.createVertexArray();
+        gl.bindVertexArray(this.stateVao);
+        gl.bindBuffer(gl.ARRAY_BUFFER, this.quadBuffer);
+        gl.enableVertexAttribArray(0);
+        gl.vertexAttribPointer(0, 2, gl.FLOAT, false, 0, 0);
+        gl.bindBuffer(gl.ARRAY_BUFFER, this.stateBuffer);
+        gl.enableVertexAttribArray(1);
+        gl.vertexAttribPointer(1, 4, gl.FLOAT, false, GL_STATE_STRIDE * 4, 0);
+        gl.vertexAttribDivisor(1, 1);
+        gl.bindBuffer(gl.ARRAY_BUFFER, this.radiusBuffer);
+        gl.enableVertexAttribArray(2);
+        gl.vertexAttribPointer(2, 1, gl.FLOAT, false, 0, 0);
+        gl.vertexAttribDivisor(2, 1);
+
+        // Trail segment endpoints are re-pointed at ring rows in drawTrails().
+        this.trailVao = gl.createVertexArray();
+        gl.bindVertexArray(this.trailVao);
+        gl.bindBuffer(gl.ARRAY_BUFFER, this.segmentBuffer);
+        gl.enableVertexAttribArray(0);
+        gl.vertexAttribPointer(0, 2, gl.FLOAT, false, 0, 0);
+        gl.enableVertexAttribArray(1);
+        gl.vertexAttribDivisor(1, 1);
+        gl.enableVertexAttribArray(2);
+        gl.vertexAttribDivisor(2, 1);
+        gl.bindVertexArray(null);
+
+        gl.enable(gl.BLEND);
+        gl.blendFunc(gl.SRC_ALPHA, gl.ONE_MINUS_SRC_ALPHA);
+    }
+
+    createShader(type, source) {
+        const gl = this.gl;
+        const shader = gl.createShader(type);
+        gl.shaderSource(shader, source);
+        gl.compileShader(shader);
+        if (!gl.getShaderParameter(shader, gl.COMPILE_STATUS)) {
+            throw new Error('Shader compile failed: ' + gl.getShaderInfoLog(shader));
+        }
+        return shader;
+    }
+
+    createProgram(vertexSource, fragmentSource) {
+        const gl = this.gl;
+        const program = gl.createProgram();
+        gl.attachShader(program, this.createShader(gl.VERTEX_SHADER, vertexSource));
+        gl.attachShader(program, this.createShader(gl.FRAGMENT_SHADER, fragmentSource));
+        gl.linkProgram(program);
+        if (!gl.getProgramParameter(program, gl.LINK_STATUS)) {
+            throw new Error('Program link failed: ' + gl.getProgramInfoLog(program));
+        }
+
+        const uniforms = {};
+        const count = gl.getProgramParameter(program, gl.ACTIVE_UNIFORMS);
+        for (let u = 0; u < count; u++) {
+            const name = gl.getActiveUniform(program, u).name;
+            uniforms[name] = gl.getUniformLocation(program, name);
+        }
+        return { program, uniforms };
+    }
+
+    createBuffer(data) {
+        const gl = this.gl;
+        const buffer = gl.createBuffer();
+        gl.bindBuffer(gl.ARRAY_BUFFER, buffer);
+        gl.bufferData(gl.ARRAY_BUFFER, data, gl.STATIC_DRAW);
+        return buffer;
+    }
+
+    // (Re)sizes the state and trail buffers for `count` systems and clears the trails.
+    allocate(count) {
+        const gl = this.gl;
+        this.numSystems = count;
+        this.trailRow = new Float32Array(count * 2);
+        gl.bindBuffer(gl.ARRAY_BUFFER, this.stateBuffer);
+        gl.bufferData(gl.ARRAY_BUFFER, count * GL_STATE_STRIDE * 4, gl.DYNAMIC_DRAW);
+        gl.bindBuffer(gl.ARRAY_BUFFER, this.trailBuffer);
+        gl.bufferData(gl.ARRAY_BUFFER, GL_TRAIL_LENGTH * count * 8, gl.DYNAMIC_DRAW);
+        this.setBallRadii(null);
+        this.clearTrails();
+    }
+
+    // Per-system ball radii (a Float32Array of numSystems), or null for GL_BALL_RADIUS.
+    setBallRadii(radii) {
+        const gl = this.gl;
+        gl.bindBuffer(gl.ARRAY_BUFFER, this.radiusBuffer);
+        gl.bufferData(gl.ARRAY_BUFFER, radii ?? new Float32Array(this.numSystems).fill(GL_BALL_RADIUS), gl.STATIC_DRAW);
+    }
+
+    clearTrails() {
+        this.trailHead = 0;
+        this.trailSize = 0;
+    }
+
+    // Appends every system's current ball position as the newest trail row.
+    pushTrail(stateView) {
+        const gl = this.gl;
+        const row = this.trailRow;
+        for (let i = 0; i < this.numSystems; i++) {
+            row[i * 2] = stateView[i * GL_STATE_STRIDE];
+            row[i * 2 + 1] = stateView[i * GL_STATE_STRIDE + 1];
+        }
+        gl.bindBuffer(gl.ARRAY_BUFFER, this.trailBuffer);
+        gl.bufferSubData(gl.ARRAY_BUFFER, this.trailHead * this.numSystems * 8, row);
+
+        const nextHead = this.trailHead + 1;
+        this.trailHead = nextHead === GL_TRAIL_LENGTH ? 0 : nextHead;
+        if (this.trailSize < GL_TRAIL_LENGTH) this.trailSize++;
+    }
+
+    // Starts a frame: clears, uploads stateView and records the layout uniforms.
+    // frame: { width, height, t, layoutScale, overlayScale, overlayCenterX, overlayCenterY,
+    //          cellW, cellH, gridCols, alpha }
+    beginFrame(stateView, frame) {
+        const gl = this.gl;
+        this.frame = frame;
+        gl.viewport(0, 0, frame.width, frame.height);
+        gl.clearColor(0x22 / 255, 0x22 / 255, 0x22 / 255, 1);
+        gl.clear(gl.COLOR_BUFFER_BIT);
+        gl.bindBuffer(gl.ARRAY_BUFFER, this.stateBuffer);
+        gl.bufferSubData(gl.ARRAY_BUFFER, 0, stateView, 0, this.numSystems * GL_STATE_STRIDE);
+    }
+
+    useProgram(entry) {
+        const gl = this.gl;
+        const u = entry.uniforms;
+        const f = this.frame;
+        gl.useProgram(entry.program);
+        gl.uniform2f(u.u_viewport, f.width, f.height);
+        gl.uniform1f(u.u_t, f.t);
+        gl.uniform1f(u.u_layoutScale, f.layoutScale);
+        gl.uniform1f(u.u_overlayScale, f.overlayScale);
+        gl.uniform2f(u.u_overlayCenter, f.overlayCenterX, f.overlayCenterY);
+        gl.uniform2f(u.u_cell, f.cellW, f.cellH);
+        gl.uniform1i(u.u_gridCols, f.gridCols);
+        gl.uniform1i(u.u_numSystems, this.numSystems);
+        gl.uniform1f(u.u_alpha, f.alpha);
+    }
+
+    drawContainers() {
+        const gl = this.gl;
+        this.useProgram(this.containerProgram);
+        gl.bindVertexArray(this.stateVao);
+        gl.drawArraysInstanced(gl.TRIANGLE_STRIP, 0, 4, this.numSystems);
+    }
+
+    drawBalls() {
+        const gl = this.gl;
+        this.useProgram(this.ballProgram);
+        gl.bindVertexArray(this.stateVao);
+        gl.drawArraysInstanced(gl.TRIANGLE_STRIP, 0, 4, this.numSystems);
+    }
+
+    // One instance per (segment, system). Consecutive ring rows are contiguous except
+    // across the wrap, so the ring takes at most three draws.
+    drawTrails() {
+        const gl = this.gl;
+        const n = this.numSystems;
+        if (this.trailSize < 2) return;
+
+        this.useProgram(this.trailProgram);
+        gl.bindVertexArray(this.trailVao);
+        gl.bindBuffer(gl.ARRAY_BUFFER, this.trailBuffer);
+
+        const rowBytes = n * 8;
+        let row = this.trailHead - this.trailSize;
+        if (row < 0) row += GL_TRAIL_LENGTH;
+        let remaining = this.trailSize - 1;
+        while (remaining > 0) {
+            const wraps = row === GL_TRAIL_LENGTH - 1;
+            const segments = wraps ? 1 : Math.min(remaining, GL_TRAIL_LENGTH - 1 - row);
+            gl.vertexAttribPointer(1, 2, gl.FLOAT, false, 0, row * rowBytes);
+            gl.vertexAttribPointer(2, 2, gl.FLOAT, false, 0, wraps ? 0 : (row + 1) * rowBytes);
+            gl.drawArraysInstanced(gl.TRIANGLE_STRIP, 0, 4, segments * n);
+            row = wraps ? 0 : row + segments;
+            remaining -= segments;
+        }
+    }
+
+    endFrame() {
+        this.gl.bindVertexArray(null);
+    }
+}
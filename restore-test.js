@@ -0,0 +1,108 @@
+// Snapshot/Restore Check Across System Counts
+//
+//   node restore-test.js [--workers=2]
+//
+// Runs engine.js headless in Node (message mode, no canvas) over real physics workers,
+// takes a snapshot, scales the multiverse up, restores the snapshot and checks that the
+// older system count comes back and stepping resumes from the restored step count. Exits
+// non-zero on failure.
+
+const fs = require('fs');
+const path = require('path');
+const vm = require('vm');
+const { Worker } = require('worker_threads');
+
+const TIMEOUT_MS = 20000;
+const SNAPSHOT_SYSTEMS = 64;
+
+const workerArg = process.argv.find((arg) => arg.startsWith('--workers='));
+const workerCount = workerArg ? parseInt(workerArg.slice('--workers='.length), 10) : 2;
+
+// A canvas whose 2D context takes every call and draws nothing.
+function nullCanvas() {
+    const context = new Proxy({}, {
+        get: (target, key) => key in target ? target[key] : () => undefined,
+        set: (target, key, value) => {
+            target[key] = value;
+            return true;
+        }
+    });
+    const target = { width: 1, height: 1, getContext: (type) => type === '2d' ? context : null };
+    context.canvas = target;
+    return target;
+}
+
+// Physics workers as worker_threads behind the browser Worker interface engine.js uses.
+class ThreadWorker {
+    constructor(file) {
+        this.onmessage = null;
+        this.thread = new Worker(path.join(__dirname, file));
+        this.thread.on('message', (data) => this.onmessage({ data }));
+    }
+    postMessage(msg, transfer) {
+        this.thread.postMessage(msg, transfer);
+    }
+    terminate() {
+        this.thread.terminate();
+    }
+}
+
+function loadPage() {
+    globalThis.self = globalThis;
+    globalThis.location = { search: `?workers=${workerCount}&systems=${SNAPSHOT_SYSTEMS}&renderer=2d` };
+    globalThis.Worker = ThreadWorker;
+    for (const file of ['ensemble.js', 'output-format.js', 'recorder.js', 'engine.js']) {
+        vm.runInThisContext(fs.readFileSync(path.join(__dirname, file), 'utf8'), { filename: file });
+    }
+    startEngine({
+        canvas: nullCanvas(),
+        graphCanvas: nullCanvas(),
+        viewport: () => ({ width: 1280, height: 720, graphWidth: 300, graphHeight: 100 }),
+        ui: { text() {}, visible() {}, title() {}, commit() {} },
+        saveFile() {}
+    });
+}
+
+// Resolves once `condition()` holds, polled once a frame.
+function until(what, condition) {
+    return new Promise((resolve, reject) => {
+        const deadline = Date.now() + TIMEOUT_MS;
+        const poll = () => {
+            if (condition()) resolve();
+            else if (Date.now() > deadline) reject(new Error(`timed out waiting for ${what}`));
+            else setTimeout(poll, 1000 / 60);
+        };
+        poll();
+    });
+}
+
+function pageState() {
+    return vm.runInThisContext('({ isReady, numSystems, simulationSteps, settled: activeWorkers === numWorkers && !stateRequest })');
+}
+
+async function run() {
+    loadPage();
+    // The pool starts on one worker and grows to --workers through a state request of its own.
+    await until('the pool to step', () => pageState().isReady && pageState().settled && pageState().simulationSteps > 0);
+
+    const blob = await vm.runInThisContext('snapshotMultiverse()');
+    const snapshotSteps = new DataView(blob).getFloat64(16, true);
+
+    vm.runInThisContext('runEngineCommand("scale", 2)');
+    await until('the scaled multiverse to step', () =>
+        pageState().numSystems === 2 * SNAPSHOT_SYSTEMS && pageState().simulationSteps > 0);
+
+    const restore = vm.runInThisContext('restoreMultiverse')(blob);
+    await Promise.race([restore, until('the restore', () => false)]);
+    if (pageState().numSystems !== SNAPSHOT_SYSTEMS) {
+        throw new Error(`restored ${pageState().numSystems} systems, expected ${SNAPSHOT_SYSTEMS}`);
+    }
+    await until('stepping to resume after the restore', () => pageState().simulationSteps > snapshotSteps);
+    console.log(`restored ${SNAPSHOT_SYSTEMS} systems at step ${snapshotSteps} from ${2 * SNAPSHOT_SYSTEMS}; ` +
+        `stepping resumed (step ${pageState().simulationSteps})`);
+}
+
+run().then(() => process.exit(0), (err) => {
+    console.error('FAIL:', err.message);
+    process.exit(1);
+});